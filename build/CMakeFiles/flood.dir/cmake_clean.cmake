@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/flood.dir/src/main.cc.o"
+  "CMakeFiles/flood.dir/src/main.cc.o.d"
+  "flood"
+  "flood.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/flood.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,45 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/foreign/dequeobj_foreign.cc" "CMakeFiles/flood_runtime.dir/foreign/dequeobj_foreign.cc.o" "gcc" "CMakeFiles/flood_runtime.dir/foreign/dequeobj_foreign.cc.o.d"
+  "/root/repo/foreign/f64arrayobj_foreign.cc" "CMakeFiles/flood_runtime.dir/foreign/f64arrayobj_foreign.cc.o" "gcc" "CMakeFiles/flood_runtime.dir/foreign/f64arrayobj_foreign.cc.o.d"
+  "/root/repo/foreign/listobj_foreign.cc" "CMakeFiles/flood_runtime.dir/foreign/listobj_foreign.cc.o" "gcc" "CMakeFiles/flood_runtime.dir/foreign/listobj_foreign.cc.o.d"
+  "/root/repo/foreign/mapobj_foreign.cc" "CMakeFiles/flood_runtime.dir/foreign/mapobj_foreign.cc.o" "gcc" "CMakeFiles/flood_runtime.dir/foreign/mapobj_foreign.cc.o.d"
+  "/root/repo/foreign/stringobj_foreign.cc" "CMakeFiles/flood_runtime.dir/foreign/stringobj_foreign.cc.o" "gcc" "CMakeFiles/flood_runtime.dir/foreign/stringobj_foreign.cc.o.d"
+  "/root/repo/libflood/arena.cc" "CMakeFiles/flood_runtime.dir/libflood/arena.cc.o" "gcc" "CMakeFiles/flood_runtime.dir/libflood/arena.cc.o.d"
+  "/root/repo/libflood/f64kernels.cc" "CMakeFiles/flood_runtime.dir/libflood/f64kernels.cc.o" "gcc" "CMakeFiles/flood_runtime.dir/libflood/f64kernels.cc.o.d"
+  "/root/repo/src/aot.cc" "CMakeFiles/flood_runtime.dir/src/aot.cc.o" "gcc" "CMakeFiles/flood_runtime.dir/src/aot.cc.o.d"
+  "/root/repo/src/ast.cc" "CMakeFiles/flood_runtime.dir/src/ast.cc.o" "gcc" "CMakeFiles/flood_runtime.dir/src/ast.cc.o.d"
+  "/root/repo/src/chunk.cc" "CMakeFiles/flood_runtime.dir/src/chunk.cc.o" "gcc" "CMakeFiles/flood_runtime.dir/src/chunk.cc.o.d"
+  "/root/repo/src/compile.cc" "CMakeFiles/flood_runtime.dir/src/compile.cc.o" "gcc" "CMakeFiles/flood_runtime.dir/src/compile.cc.o.d"
+  "/root/repo/src/debug.cc" "CMakeFiles/flood_runtime.dir/src/debug.cc.o" "gcc" "CMakeFiles/flood_runtime.dir/src/debug.cc.o.d"
+  "/root/repo/src/error.cc" "CMakeFiles/flood_runtime.dir/src/error.cc.o" "gcc" "CMakeFiles/flood_runtime.dir/src/error.cc.o.d"
+  "/root/repo/src/foreign.cc" "CMakeFiles/flood_runtime.dir/src/foreign.cc.o" "gcc" "CMakeFiles/flood_runtime.dir/src/foreign.cc.o.d"
+  "/root/repo/src/gc.cc" "CMakeFiles/flood_runtime.dir/src/gc.cc.o" "gcc" "CMakeFiles/flood_runtime.dir/src/gc.cc.o.d"
+  "/root/repo/src/jit.cc" "CMakeFiles/flood_runtime.dir/src/jit.cc.o" "gcc" "CMakeFiles/flood_runtime.dir/src/jit.cc.o.d"
+  "/root/repo/src/object.cc" "CMakeFiles/flood_runtime.dir/src/object.cc.o" "gcc" "CMakeFiles/flood_runtime.dir/src/object.cc.o.d"
+  "/root/repo/src/optimize.cc" "CMakeFiles/flood_runtime.dir/src/optimize.cc.o" "gcc" "CMakeFiles/flood_runtime.dir/src/optimize.cc.o.d"
+  "/root/repo/src/parse.cc" "CMakeFiles/flood_runtime.dir/src/parse.cc.o" "gcc" "CMakeFiles/flood_runtime.dir/src/parse.cc.o.d"
+  "/root/repo/src/peephole.cc" "CMakeFiles/flood_runtime.dir/src/peephole.cc.o" "gcc" "CMakeFiles/flood_runtime.dir/src/peephole.cc.o.d"
+  "/root/repo/src/regcompile.cc" "CMakeFiles/flood_runtime.dir/src/regcompile.cc.o" "gcc" "CMakeFiles/flood_runtime.dir/src/regcompile.cc.o.d"
+  "/root/repo/src/regvm.cc" "CMakeFiles/flood_runtime.dir/src/regvm.cc.o" "gcc" "CMakeFiles/flood_runtime.dir/src/regvm.cc.o.d"
+  "/root/repo/src/scan.cc" "CMakeFiles/flood_runtime.dir/src/scan.cc.o" "gcc" "CMakeFiles/flood_runtime.dir/src/scan.cc.o.d"
+  "/root/repo/src/sema.cc" "CMakeFiles/flood_runtime.dir/src/sema.cc.o" "gcc" "CMakeFiles/flood_runtime.dir/src/sema.cc.o.d"
+  "/root/repo/src/serialize.cc" "CMakeFiles/flood_runtime.dir/src/serialize.cc.o" "gcc" "CMakeFiles/flood_runtime.dir/src/serialize.cc.o.d"
+  "/root/repo/src/value.cc" "CMakeFiles/flood_runtime.dir/src/value.cc.o" "gcc" "CMakeFiles/flood_runtime.dir/src/value.cc.o.d"
+  "/root/repo/src/vm.cc" "CMakeFiles/flood_runtime.dir/src/vm.cc.o" "gcc" "CMakeFiles/flood_runtime.dir/src/vm.cc.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
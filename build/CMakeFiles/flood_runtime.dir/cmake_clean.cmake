@@ -0,0 +1,63 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/flood_runtime.dir/foreign/dequeobj_foreign.cc.o"
+  "CMakeFiles/flood_runtime.dir/foreign/dequeobj_foreign.cc.o.d"
+  "CMakeFiles/flood_runtime.dir/foreign/f64arrayobj_foreign.cc.o"
+  "CMakeFiles/flood_runtime.dir/foreign/f64arrayobj_foreign.cc.o.d"
+  "CMakeFiles/flood_runtime.dir/foreign/listobj_foreign.cc.o"
+  "CMakeFiles/flood_runtime.dir/foreign/listobj_foreign.cc.o.d"
+  "CMakeFiles/flood_runtime.dir/foreign/mapobj_foreign.cc.o"
+  "CMakeFiles/flood_runtime.dir/foreign/mapobj_foreign.cc.o.d"
+  "CMakeFiles/flood_runtime.dir/foreign/stringobj_foreign.cc.o"
+  "CMakeFiles/flood_runtime.dir/foreign/stringobj_foreign.cc.o.d"
+  "CMakeFiles/flood_runtime.dir/libflood/arena.cc.o"
+  "CMakeFiles/flood_runtime.dir/libflood/arena.cc.o.d"
+  "CMakeFiles/flood_runtime.dir/libflood/f64kernels.cc.o"
+  "CMakeFiles/flood_runtime.dir/libflood/f64kernels.cc.o.d"
+  "CMakeFiles/flood_runtime.dir/src/aot.cc.o"
+  "CMakeFiles/flood_runtime.dir/src/aot.cc.o.d"
+  "CMakeFiles/flood_runtime.dir/src/ast.cc.o"
+  "CMakeFiles/flood_runtime.dir/src/ast.cc.o.d"
+  "CMakeFiles/flood_runtime.dir/src/chunk.cc.o"
+  "CMakeFiles/flood_runtime.dir/src/chunk.cc.o.d"
+  "CMakeFiles/flood_runtime.dir/src/compile.cc.o"
+  "CMakeFiles/flood_runtime.dir/src/compile.cc.o.d"
+  "CMakeFiles/flood_runtime.dir/src/debug.cc.o"
+  "CMakeFiles/flood_runtime.dir/src/debug.cc.o.d"
+  "CMakeFiles/flood_runtime.dir/src/error.cc.o"
+  "CMakeFiles/flood_runtime.dir/src/error.cc.o.d"
+  "CMakeFiles/flood_runtime.dir/src/foreign.cc.o"
+  "CMakeFiles/flood_runtime.dir/src/foreign.cc.o.d"
+  "CMakeFiles/flood_runtime.dir/src/gc.cc.o"
+  "CMakeFiles/flood_runtime.dir/src/gc.cc.o.d"
+  "CMakeFiles/flood_runtime.dir/src/jit.cc.o"
+  "CMakeFiles/flood_runtime.dir/src/jit.cc.o.d"
+  "CMakeFiles/flood_runtime.dir/src/object.cc.o"
+  "CMakeFiles/flood_runtime.dir/src/object.cc.o.d"
+  "CMakeFiles/flood_runtime.dir/src/optimize.cc.o"
+  "CMakeFiles/flood_runtime.dir/src/optimize.cc.o.d"
+  "CMakeFiles/flood_runtime.dir/src/parse.cc.o"
+  "CMakeFiles/flood_runtime.dir/src/parse.cc.o.d"
+  "CMakeFiles/flood_runtime.dir/src/peephole.cc.o"
+  "CMakeFiles/flood_runtime.dir/src/peephole.cc.o.d"
+  "CMakeFiles/flood_runtime.dir/src/regcompile.cc.o"
+  "CMakeFiles/flood_runtime.dir/src/regcompile.cc.o.d"
+  "CMakeFiles/flood_runtime.dir/src/regvm.cc.o"
+  "CMakeFiles/flood_runtime.dir/src/regvm.cc.o.d"
+  "CMakeFiles/flood_runtime.dir/src/scan.cc.o"
+  "CMakeFiles/flood_runtime.dir/src/scan.cc.o.d"
+  "CMakeFiles/flood_runtime.dir/src/sema.cc.o"
+  "CMakeFiles/flood_runtime.dir/src/sema.cc.o.d"
+  "CMakeFiles/flood_runtime.dir/src/serialize.cc.o"
+  "CMakeFiles/flood_runtime.dir/src/serialize.cc.o.d"
+  "CMakeFiles/flood_runtime.dir/src/value.cc.o"
+  "CMakeFiles/flood_runtime.dir/src/value.cc.o.d"
+  "CMakeFiles/flood_runtime.dir/src/vm.cc.o"
+  "CMakeFiles/flood_runtime.dir/src/vm.cc.o.d"
+  "libflood_runtime.a"
+  "libflood_runtime.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/flood_runtime.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
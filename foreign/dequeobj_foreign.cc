@@ -0,0 +1,74 @@
+#include "../src/foreign.h"
+
+static DequeObj *deque_new(VM &vm)
+{
+    return alloc<DequeObj>(vm);
+}
+
+static void deque_push_back(Value val, DequeObj *self)
+{
+    self->vals.push_back(val);
+}
+
+static void deque_push_front(Value val, DequeObj *self)
+{
+    self->vals.push_front(val);
+}
+
+static Value deque_pop_back(DequeObj *self)
+{
+    if (self->vals.len() == 0)
+        throw "pop from empty deque";
+    Value val = self->vals[self->vals.len() - 1];
+    self->vals.pop_back();
+    return val;
+}
+
+static Value deque_pop_front(DequeObj *self)
+{
+    if (self->vals.len() == 0)
+        throw "pop from empty deque";
+    Value val = self->vals[0];
+    self->vals.pop_front();
+    return val;
+}
+
+static Value deque_peek_back(DequeObj *self)
+{
+    if (self->vals.len() == 0)
+        throw "peek at empty deque";
+    return self->vals[self->vals.len() - 1];
+}
+
+static Value deque_peek_front(DequeObj *self)
+{
+    if (self->vals.len() == 0)
+        throw "peek at empty deque";
+    return self->vals[0];
+}
+
+static double deque_len(DequeObj *self)
+{
+    return self->vals.len();
+}
+
+static ListObj *deque_to_list(VM &vm, DequeObj *self)
+{
+    Dynarr<Value> vals;
+    for (i32 i = 0; i < self->vals.len(); i++)
+        vals.push(self->vals[i]);
+    return alloc<ListObj>(vm, move(vals));
+}
+
+void define_deque_methods(VM &vm)
+{
+    define_foreign_fn<deque_new>(vm, "Deque");
+    define_foreign_method<deque_push_back>(vm, *vm.deque_class, "push_back");
+    define_foreign_method<deque_push_front>(vm, *vm.deque_class, "push_front");
+    define_foreign_method<deque_pop_back>(vm, *vm.deque_class, "pop_back");
+    define_foreign_method<deque_pop_front>(vm, *vm.deque_class, "pop_front");
+    define_foreign_method<deque_peek_back>(vm, *vm.deque_class, "peek_back");
+    define_foreign_method<deque_peek_front>(vm, *vm.deque_class, "peek_front");
+    define_foreign_method<deque_len>(vm, *vm.deque_class, "len");
+    define_foreign_method<deque_to_list>(vm, *vm.deque_class, "to_list");
+}
@@ -0,0 +1,88 @@
+#include "../libflood/f64kernels.h"
+#include "../src/foreign.h"
+#include <string.h>
+
+static F64ArrayObj *f64array_new(VM &vm, double len)
+{
+    if (len != i32(len) || len < 0)
+        throw "f64 array length must be a non-negative integer";
+    return alloc<F64ArrayObj>(vm, i32(len));
+}
+
+static double f64array_len(F64ArrayObj *self)
+{
+    return self->len;
+}
+
+static double f64array_sum(F64ArrayObj *self)
+{
+    return f64_kernels().sum(self->vals, self->len);
+}
+
+static double f64array_dot(F64ArrayObj *other, F64ArrayObj *self)
+{
+    if (other->len != self->len)
+        throw "f64 array lengths differ";
+    return f64_kernels().dot(self->vals, other->vals, self->len);
+}
+
+static void f64array_scale(double k, F64ArrayObj *self)
+{
+    f64_kernels().scale(self->vals, self->len, k);
+}
+
+static void f64array_add(F64ArrayObj *other, F64ArrayObj *self)
+{
+    if (other->len != self->len)
+        throw "f64 array lengths differ";
+    f64_kernels().add(self->vals, other->vals, self->len);
+}
+
+static double f64array_min(F64ArrayObj *self)
+{
+    if (self->len == 0)
+        throw "min of empty f64 array";
+    return f64_kernels().min(self->vals, self->len);
+}
+
+static double f64array_max(F64ArrayObj *self)
+{
+    if (self->len == 0)
+        throw "max of empty f64 array";
+    return f64_kernels().max(self->vals, self->len);
+}
+
+static void f64array_fill(double val, F64ArrayObj *self)
+{
+    f64_kernels().fill(self->vals, self->len, val);
+}
+
+static F64ArrayObj *f64array_copy(VM &vm, F64ArrayObj *self)
+{
+    F64ArrayObj *copy = alloc<F64ArrayObj>(vm, self->len);
+    memcpy(copy->vals, self->vals, self->len * sizeof(double));
+    return copy;
+}
+
+static ListObj *f64array_to_list(VM &vm, F64ArrayObj *self)
+{
+    Dynarr<Value> vals;
+    for (i32 i = 0; i < self->len; i++)
+        vals.push(MK_NUM(self->vals[i]));
+    return alloc<ListObj>(vm, move(vals));
+}
+
+void define_f64array_methods(VM &vm)
+{
+    define_foreign_fn<f64array_new>(vm, "F64Array");
+    define_foreign_method<f64array_len>(vm, *vm.f64array_class, "len");
+    define_foreign_method<f64array_sum>(vm, *vm.f64array_class, "sum");
+    define_foreign_method<f64array_dot>(vm, *vm.f64array_class, "dot");
+    define_foreign_method<f64array_scale>(vm, *vm.f64array_class, "scale");
+    define_foreign_method<f64array_add>(vm, *vm.f64array_class, "add");
+    define_foreign_method<f64array_min>(vm, *vm.f64array_class, "min");
+    define_foreign_method<f64array_max>(vm, *vm.f64array_class, "max");
+    define_foreign_method<f64array_fill>(vm, *vm.f64array_class, "fill");
+    define_foreign_method<f64array_copy>(vm, *vm.f64array_class, "copy");
+    define_foreign_method<f64array_to_list>(vm, *vm.f64array_class, "to_list");
+}
@@ -0,0 +1,3 @@
+#include "../src/vm.h"
+
+void define_f64array_methods(VM &vm);
@@ -2,21 +2,21 @@
 
 static void list_push(Value val, ListObj *self)
 {
-    self->vals.push(val);
+    self->push(val);
 }
 
 static Value list_pop(ListObj *self)
 {
-    if (self->vals.len() == 0)
+    if (self->len() == 0)
         throw "pop from empty list";
-    Value val = self->vals[self->vals.len() - 1];
-    self->vals.pop();
+    Value val = self->get(self->len() - 1);
+    self->pop();
     return val;
 }
 
 static double list_len(ListObj *self)
 {
-    return self->vals.len();
+    return self->len();
 }
 
 void define_list_methods(VM &vm)
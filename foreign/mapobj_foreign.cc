@@ -0,0 +1,96 @@
+#include "../src/foreign.h"
+
+static ListObj *map_entries_to_list(VM &vm, ValMap &map, const bool keys)
+{
+    Dynarr<Value> vals;
+    for (i32 i = 0; i < map.cap(); i++) {
+        const MapEntry &entry = map.slot(i);
+        if (entry.state == MAP_SLOT_FULL)
+            vals.push(keys ? entry.key : entry.val);
+    }
+    return alloc<ListObj>(vm, move(vals));
+}
+
+static MapObj *map_new(VM &vm)
+{
+    return alloc<MapObj>(vm);
+}
+
+static bool map_has(Value key, MapObj *self)
+{
+    return self->map.find(key) != nullptr;
+}
+
+static Value map_get(Value key, Value fallback, MapObj *self)
+{
+    Value *val = self->map.find(key);
+    return val ? *val : fallback;
+}
+
+static bool map_remove(Value key, MapObj *self)
+{
+    return self->map.remove(key);
+}
+
+static double map_len(MapObj *self)
+{
+    return self->map.len();
+}
+
+static ListObj *map_keys(VM &vm, MapObj *self)
+{
+    return map_entries_to_list(vm, self->map, true);
+}
+
+static ListObj *map_values(VM &vm, MapObj *self)
+{
+    return map_entries_to_list(vm, self->map, false);
+}
+
+static SetObj *set_new(VM &vm)
+{
+    return alloc<SetObj>(vm);
+}
+
+static void set_add(Value key, SetObj *self)
+{
+    self->map.insert(key, MK_NULL);
+}
+
+static bool set_has(Value key, SetObj *self)
+{
+    return self->map.find(key) != nullptr;
+}
+
+static bool set_remove(Value key, SetObj *self)
+{
+    return self->map.remove(key);
+}
+
+static double set_len(SetObj *self)
+{
+    return self->map.len();
+}
+
+static ListObj *set_to_list(VM &vm, SetObj *self)
+{
+    return map_entries_to_list(vm, self->map, true);
+}
+
+void define_map_methods(VM &vm)
+{
+    define_foreign_fn<map_new>(vm, "Map");
+    define_foreign_method<map_has>(vm, *vm.map_class, "has");
+    define_foreign_method<map_get>(vm, *vm.map_class, "get");
+    define_foreign_method<map_remove>(vm, *vm.map_class, "remove");
+    define_foreign_method<map_len>(vm, *vm.map_class, "len");
+    define_foreign_method<map_keys>(vm, *vm.map_class, "keys");
+    define_foreign_method<map_values>(vm, *vm.map_class, "values");
+
+    define_foreign_fn<set_new>(vm, "Set");
+    define_foreign_method<set_add>(vm, *vm.set_class, "add");
+    define_foreign_method<set_has>(vm, *vm.set_class, "has");
+    define_foreign_method<set_remove>(vm, *vm.set_class, "remove");
+    define_foreign_method<set_len>(vm, *vm.set_class, "len");
+    define_foreign_method<set_to_list>(vm, *vm.set_class, "to_list");
+}
@@ -0,0 +1,3 @@
+#include "../src/vm.h"
+
+void define_map_methods(VM &vm);
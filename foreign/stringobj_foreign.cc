@@ -0,0 +1,108 @@
+#include "../src/foreign.h"
+#include <stdio.h>
+#include <string.h>
+
+static double string_len(StringObj *self)
+{
+    return self->len;
+}
+
+static StringObj *string_slice(VM &vm, double start, double end, StringObj *self)
+{
+    if (start != i32(start) || end != i32(end))
+        throw "slice indices must be integers";
+    if (start < 0 || end > self->len || start > end)
+        throw "slice out of bounds";
+    return slice_string(vm, self, start, end);
+}
+
+// returns index of first occurrence of sub in self at or after start, or -1
+static i32 find_from(StringObj *self, StringObj *sub, i32 start)
+{
+    const char *chars = self->data();
+    const char *sub_chars = sub->data();
+    for (i32 i = start; i + sub->len <= self->len; i++) {
+        if (memcmp(chars + i, sub_chars, sub->len) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static double string_find(StringObj *sub, StringObj *self)
+{
+    return find_from(self, sub, 0);
+}
+
+// the pieces are slices of self, so splitting allocates no character data
+static ListObj *string_split(VM &vm, StringObj *sep, StringObj *self)
+{
+    if (sep->len == 0)
+        throw "empty separator";
+    Dynarr<Value> pieces;
+    i32 start = 0;
+    i32 i;
+    while ((i = find_from(self, sep, start)) != -1) {
+        pieces.push(MK_OBJ(slice_string(vm, self, start, i)));
+        start = i + sep->len;
+    }
+    pieces.push(MK_OBJ(slice_string(vm, self, start, self->len)));
+    return alloc<ListObj>(vm, move(pieces));
+}
+
+static StringBuilderObj *string_builder_new(VM &vm)
+{
+    return alloc<StringBuilderObj>(vm);
+}
+
+static void builder_push_chars(StringBuilderObj *self, const char *chars, const i32 len)
+{
+    for (i32 i = 0; i < len; i++)
+        self->chars.push(chars[i]);
+}
+
+static StringBuilderObj *builder_append(Value val, StringBuilderObj *self)
+{
+    if (IS_STRING(val)) {
+        builder_push_chars(self, AS_STRING(val)->data(), AS_STRING(val)->len);
+    } else if (IS_NUM(val)) {
+        char buf[32];
+        const i32 len = snprintf(buf, sizeof(buf), "%.14g", AS_NUM(val));
+        builder_push_chars(self, buf, len);
+    } else if (IS_BOOL(val)) {
+        builder_push_chars(self, AS_BOOL(val) ? "true" : "false", AS_BOOL(val) ? 4 : 5);
+    } else if (IS_NULL(val)) {
+        builder_push_chars(self, "null", 4);
+    } else {
+        throw "can only append strings, numbers, booleans and null";
+    }
+    return self;
+}
+
+static double builder_len(StringBuilderObj *self)
+{
+    return self->chars.len();
+}
+
+static void builder_clear(StringBuilderObj *self)
+{
+    self->chars = Dynarr<char>();
+}
+
+static StringObj *builder_build(VM &vm, StringBuilderObj *self)
+{
+    return alloc<StringObj>(vm, String(self->chars.raw(), self->chars.len()));
+}
+
+void define_string_methods(VM &vm)
+{
+    define_foreign_method<string_len>(vm, *vm.string_class, "len");
+    define_foreign_method<string_slice>(vm, *vm.string_class, "slice");
+    define_foreign_method<string_find>(vm, *vm.string_class, "find");
+    define_foreign_method<string_split>(vm, *vm.string_class, "split");
+
+    define_foreign_fn<string_builder_new>(vm, "StringBuilder");
+    define_foreign_method<builder_append>(vm, *vm.string_builder_class, "append");
+    define_foreign_method<builder_len>(vm, *vm.string_builder_class, "len");
+    define_foreign_method<builder_clear>(vm, *vm.string_builder_class, "clear");
+    define_foreign_method<builder_build>(vm, *vm.string_builder_class, "build");
+}
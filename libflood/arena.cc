@@ -1,19 +1,37 @@
 #include "arena.h"
+#include <sys/mman.h>
+#include <unistd.h> // for sysconf()
 
 Arena::~Arena()
 {
-    delete[] stack_mem;
-    stack_mem = nullptr;
-    stack_pos = 0;
+    for (i32 i = 0; i < blocks_.len(); i++)
+        munmap(blocks_[i].base, blocks_[i].cap);
 }
 
-u8 *Arena::push(const i64 size)
+u8 *Arena::push(const i64 size, const u64 align)
 {
-    if (stack_pos + size > ARENA_SIZE) {
+    if (blocks_.len() > 0) {
+        const Block &block = blocks_[blocks_.len() - 1];
+        const u64 start = (pos_ + align - 1) & ~(align - 1);
+        if (start + size <= block.cap) {
+            pos_ = start + size;
+            return block.base + start;
+        }
+    }
+    // blocks are mapped page aligned, so a push at the start of one is aligned
+    u64 cap = blocks_.len() == 0 ? ARENA_FIRST_BLOCK : blocks_[blocks_.len() - 1].cap * 2;
+    if (cap > ARENA_MAX_BLOCK)
+        cap = ARENA_MAX_BLOCK;
+    if (cap < u64(size)) {
+        const u64 page = sysconf(_SC_PAGESIZE);
+        cap = (u64(size) + page - 1) & ~(page - 1);
+    }
+    void *base = mmap(nullptr, cap, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
         printf("arena out of memory\n");
         exit(1);
     }
-    u8 *ptr = stack_mem + stack_pos;
-    stack_pos += size;
-    return ptr;
+    blocks_.push({static_cast<u8 *>(base), cap});
+    pos_ = size;
+    return static_cast<u8 *>(base);
 }
@@ -1,33 +1,43 @@
 #pragma once
 #include "common.h"
 #include "dynarr.h"
+#include <stddef.h> // for max_align_t
 #include <stdio.h>
 #include <stdlib.h>
 #include <type_traits>
 
-#define ARENA_SIZE (1 << 30)
+#define ARENA_FIRST_BLOCK (64 * 1024)        // each block after the first is twice as large as the one before it
+#define ARENA_MAX_BLOCK   (64 * 1024 * 1024) // up to this size, unless a single push needs more
 
+// memory is mapped in blocks as it is needed. nothing pushed is freed on its own, everything is freed with the arena, so
+// the ast is released by letting its arena go out of scope (see main and aot_main)
 class Arena {
-    u8 *stack_mem;
-    u64 stack_pos;
+    struct Block {
+        u8 *base;
+        u64 cap;
+    };
+    Dynarr<Block> blocks_; // the last one is pushed into
+    u64 pos_;              // offset of the next push in it
 
 public:
-    Arena() : stack_mem(new u8[ARENA_SIZE]), stack_pos(0) {}
+    Arena() : pos_(0) {}
     ~Arena();
-    u8 *push(const i64 size);
+    // align must be a power of two
+    u8 *push(const i64 size, const u64 align = alignof(max_align_t));
 };
 
 template <typename T, typename... Args>
 T *alloc(Arena &arena, Args &&...args)
 {
-    return new (arena.push(sizeof(T))) T(forward<Args>(args)...);
+    return new (arena.push(sizeof(T), alignof(T))) T(forward<Args>(args)...);
 }
 
+// copies cnt vals into the arena, T must be trivially copyable
 template <typename T>
-T *move_dynarr(Arena &arena, Dynarr<T> &&dynarr)
+T *copy_slice(Arena &arena, const T *vals, const i32 cnt)
 {
-    T *vals = reinterpret_cast<T *>(arena.push(dynarr.len() * sizeof(T)));
-    for (i32 i = 0; i < dynarr.len(); i++)
-        new (vals + i) T(move(dynarr[i]));
-    return vals;
+    static_assert(__is_trivially_copyable(T));
+    T *slice = reinterpret_cast<T *>(arena.push(cnt * sizeof(T), alignof(T)));
+    memcpy(slice, vals, cnt * sizeof(T));
+    return slice;
 }
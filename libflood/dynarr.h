@@ -2,6 +2,7 @@
 #include "common.h"
 #include "templates.h"
 #include <new>
+#include <string.h>
 
 template <typename T>
 class Dynarr {
@@ -43,6 +44,14 @@ public:
         }
     }
 
+    // copies cnt elements with a single memcpy, T must be trivially copyable
+    Dynarr(const T *vals, const i32 cnt)
+        : cnt(cnt), cap(cnt > 8 ? cnt : 8), vals(static_cast<T *>(operator new(cap * sizeof(T))))
+    {
+        static_assert(__is_trivially_copyable(T));
+        memcpy(this->vals, vals, cnt * sizeof(T));
+    }
+
     Dynarr(Dynarr &&other) : cnt(other.cnt), cap(other.cap), vals(other.vals)
     {
         other.cnt = 0;
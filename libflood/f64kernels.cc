@@ -0,0 +1,333 @@
+#include "f64kernels.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define F64_KERNELS_X86
+#endif
+
+static double sum_scalar(const double *a, const i32 n)
+{
+    double s = 0;
+    for (i32 i = 0; i < n; i++)
+        s += a[i];
+    return s;
+}
+
+static double dot_scalar(const double *a, const double *b, const i32 n)
+{
+    double s = 0;
+    for (i32 i = 0; i < n; i++)
+        s += a[i] * b[i];
+    return s;
+}
+
+static void scale_scalar(double *a, const i32 n, const double k)
+{
+    for (i32 i = 0; i < n; i++)
+        a[i] *= k;
+}
+
+static void add_scalar(double *a, const double *b, const i32 n)
+{
+    for (i32 i = 0; i < n; i++)
+        a[i] += b[i];
+}
+
+// min and max of an array with a NaN in it are its first NaN, whatever kernel runs. the vector kernels only note that
+// they saw one and look for it after the loop
+static double first_nan(const double *a, const i32 n)
+{
+    for (i32 i = 0; i < n; i++) {
+        if (a[i] != a[i])
+            return a[i];
+    }
+    return 0;
+}
+
+static double min_scalar(const double *a, const i32 n)
+{
+    double m = a[0];
+    for (i32 i = 0; i < n; i++) {
+        if (a[i] != a[i])
+            return a[i];
+        m = a[i] < m ? a[i] : m;
+    }
+    return m;
+}
+
+static double max_scalar(const double *a, const i32 n)
+{
+    double m = a[0];
+    for (i32 i = 0; i < n; i++) {
+        if (a[i] != a[i])
+            return a[i];
+        m = a[i] > m ? a[i] : m;
+    }
+    return m;
+}
+
+static void fill_scalar(double *a, const i32 n, const double v)
+{
+    for (i32 i = 0; i < n; i++)
+        a[i] = v;
+}
+
+static const F64Kernels kernels_scalar = {
+    "scalar", sum_scalar, dot_scalar, scale_scalar, add_scalar, min_scalar, max_scalar, fill_scalar};
+
+#ifdef F64_KERNELS_X86
+// SSE2 is part of the x86-64 baseline so these need no target attribute
+
+static double sum_sse2(const double *a, const i32 n)
+{
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    i32 i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc0 = _mm_add_pd(acc0, _mm_loadu_pd(a + i));
+        acc1 = _mm_add_pd(acc1, _mm_loadu_pd(a + i + 2));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+    double s = lanes[0] + lanes[1];
+    for (; i < n; i++)
+        s += a[i];
+    return s;
+}
+
+static double dot_sse2(const double *a, const double *b, const i32 n)
+{
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    i32 i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+    double s = lanes[0] + lanes[1];
+    for (; i < n; i++)
+        s += a[i] * b[i];
+    return s;
+}
+
+static void scale_sse2(double *a, const i32 n, const double k)
+{
+    const __m128d kv = _mm_set1_pd(k);
+    i32 i = 0;
+    for (; i + 2 <= n; i += 2)
+        _mm_storeu_pd(a + i, _mm_mul_pd(_mm_loadu_pd(a + i), kv));
+    for (; i < n; i++)
+        a[i] *= k;
+}
+
+static void add_sse2(double *a, const double *b, const i32 n)
+{
+    i32 i = 0;
+    for (; i + 2 <= n; i += 2)
+        _mm_storeu_pd(a + i, _mm_add_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    for (; i < n; i++)
+        a[i] += b[i];
+}
+
+static double min_sse2(const double *a, const i32 n)
+{
+    __m128d m = _mm_set1_pd(a[0]);
+    __m128d nan = _mm_setzero_pd();
+    i32 i = 0;
+    for (; i + 2 <= n; i += 2) {
+        const __m128d v = _mm_loadu_pd(a + i);
+        m = _mm_min_pd(m, v);
+        nan = _mm_or_pd(nan, _mm_cmpunord_pd(v, v));
+    }
+    if (_mm_movemask_pd(nan))
+        return first_nan(a, n);
+    double lanes[2];
+    _mm_storeu_pd(lanes, m);
+    double s = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+    for (; i < n; i++) {
+        if (a[i] != a[i])
+            return a[i];
+        s = a[i] < s ? a[i] : s;
+    }
+    return s;
+}
+
+static double max_sse2(const double *a, const i32 n)
+{
+    __m128d m = _mm_set1_pd(a[0]);
+    __m128d nan = _mm_setzero_pd();
+    i32 i = 0;
+    for (; i + 2 <= n; i += 2) {
+        const __m128d v = _mm_loadu_pd(a + i);
+        m = _mm_max_pd(m, v);
+        nan = _mm_or_pd(nan, _mm_cmpunord_pd(v, v));
+    }
+    if (_mm_movemask_pd(nan))
+        return first_nan(a, n);
+    double lanes[2];
+    _mm_storeu_pd(lanes, m);
+    double s = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+    for (; i < n; i++) {
+        if (a[i] != a[i])
+            return a[i];
+        s = a[i] > s ? a[i] : s;
+    }
+    return s;
+}
+
+static void fill_sse2(double *a, const i32 n, const double v)
+{
+    const __m128d vv = _mm_set1_pd(v);
+    i32 i = 0;
+    for (; i + 2 <= n; i += 2)
+        _mm_storeu_pd(a + i, vv);
+    for (; i < n; i++)
+        a[i] = v;
+}
+
+static const F64Kernels kernels_sse2 = {
+    "sse2", sum_sse2, dot_sse2, scale_sse2, add_sse2, min_sse2, max_sse2, fill_sse2};
+
+#define TARGET_AVX __attribute__((target("avx")))
+
+TARGET_AVX static double sum_avx(const double *a, const i32 n)
+{
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    i32 i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(a + i));
+        acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(a + i + 4));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+    double s = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i < n; i++)
+        s += a[i];
+    return s;
+}
+
+TARGET_AVX static double dot_avx(const double *a, const double *b, const i32 n)
+{
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    i32 i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+        acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+    double s = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i < n; i++)
+        s += a[i] * b[i];
+    return s;
+}
+
+TARGET_AVX static void scale_avx(double *a, const i32 n, const double k)
+{
+    const __m256d kv = _mm256_set1_pd(k);
+    i32 i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(a + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), kv));
+    for (; i < n; i++)
+        a[i] *= k;
+}
+
+TARGET_AVX static void add_avx(double *a, const double *b, const i32 n)
+{
+    i32 i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(a + i, _mm256_add_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    for (; i < n; i++)
+        a[i] += b[i];
+}
+
+TARGET_AVX static double min_avx(const double *a, const i32 n)
+{
+    __m256d m = _mm256_set1_pd(a[0]);
+    __m256d nan = _mm256_setzero_pd();
+    i32 i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m256d v = _mm256_loadu_pd(a + i);
+        m = _mm256_min_pd(m, v);
+        nan = _mm256_or_pd(nan, _mm256_cmp_pd(v, v, _CMP_UNORD_Q));
+    }
+    if (_mm256_movemask_pd(nan))
+        return first_nan(a, n);
+    double lanes[4];
+    _mm256_storeu_pd(lanes, m);
+    double s = lanes[0];
+    for (i32 j = 1; j < 4; j++)
+        s = lanes[j] < s ? lanes[j] : s;
+    for (; i < n; i++) {
+        if (a[i] != a[i])
+            return a[i];
+        s = a[i] < s ? a[i] : s;
+    }
+    return s;
+}
+
+TARGET_AVX static double max_avx(const double *a, const i32 n)
+{
+    __m256d m = _mm256_set1_pd(a[0]);
+    __m256d nan = _mm256_setzero_pd();
+    i32 i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m256d v = _mm256_loadu_pd(a + i);
+        m = _mm256_max_pd(m, v);
+        nan = _mm256_or_pd(nan, _mm256_cmp_pd(v, v, _CMP_UNORD_Q));
+    }
+    if (_mm256_movemask_pd(nan))
+        return first_nan(a, n);
+    double lanes[4];
+    _mm256_storeu_pd(lanes, m);
+    double s = lanes[0];
+    for (i32 j = 1; j < 4; j++)
+        s = lanes[j] > s ? lanes[j] : s;
+    for (; i < n; i++) {
+        if (a[i] != a[i])
+            return a[i];
+        s = a[i] > s ? a[i] : s;
+    }
+    return s;
+}
+
+TARGET_AVX static void fill_avx(double *a, const i32 n, const double v)
+{
+    const __m256d vv = _mm256_set1_pd(v);
+    i32 i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(a + i, vv);
+    for (; i < n; i++)
+        a[i] = v;
+}
+
+static const F64Kernels kernels_avx = {"avx", sum_avx, dot_avx, scale_avx, add_avx, min_avx, max_avx, fill_avx};
+#endif
+
+static const F64Kernels &select_kernels()
+{
+    const char *requested = getenv("FLOOD_SIMD");
+    if (requested && strcmp(requested, "scalar") == 0)
+        return kernels_scalar;
+#ifdef F64_KERNELS_X86
+    if (requested && strcmp(requested, "sse2") == 0)
+        return kernels_sse2;
+    if (__builtin_cpu_supports("avx"))
+        return kernels_avx;
+    return kernels_sse2;
+#else
+    return kernels_scalar;
+#endif
+}
+
+const F64Kernels &f64_kernels()
+{
+    static const F64Kernels &kernels = select_kernels();
+    return kernels;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "common.h"
+
+// bulk operations over packed doubles. every kernel has a scalar version, and on x86-64 an SSE2 and
+// an AVX version. results of sum and dot may differ in the last bits between versions because the
+// vector versions accumulate in several lanes
+struct F64Kernels {
+    const char *name;
+    double (*sum)(const double *a, const i32 n);
+    double (*dot)(const double *a, const double *b, const i32 n);
+    void (*scale)(double *a, const i32 n, const double k);
+    void (*add)(double *a, const double *b, const i32 n); // a += b
+    double (*min)(const double *a, const i32 n);          // precondition: n > 0. the first NaN if there is one
+    double (*max)(const double *a, const i32 n);          // precondition: n > 0. the first NaN if there is one
+    void (*fill)(double *a, const i32 n, const double v);
+};
+
+// kernels for the widest instruction set the cpu supports, selected on first call.
+// setting FLOOD_SIMD to `scalar`, `sse2` or `avx` selects a narrower set
+const F64Kernels &f64_kernels();
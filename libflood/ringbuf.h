@@ -0,0 +1,95 @@
+#pragma once
+#include "common.h"
+#include "templates.h"
+#include <new>
+
+// growable ring buffer, supports O(1) push and pop at both ends and indexed access
+template <typename T>
+class Ringbuf {
+    i32 head; // physical idx of the first element
+    i32 cnt;
+    i32 cap;  // always a power of two
+    T *vals;
+
+    i32 phys(const i32 idx) const
+    {
+        return (head + idx) & (cap - 1);
+    }
+
+    void grow()
+    {
+        if (cnt == cap) {
+            // unwrap the elements to the start of the new buffer
+            T *new_vals = static_cast<T *>(operator new(cap * 2 * sizeof(T)));
+            for (i32 i = 0; i < cnt; i++) {
+                new (new_vals + i) T(move(vals[phys(i)]));
+                vals[phys(i)].~T();
+            }
+            operator delete(vals);
+            vals = new_vals;
+            head = 0;
+            cap *= 2;
+        }
+    }
+
+public:
+    Ringbuf() : head(0), cnt(0), cap(8), vals(static_cast<T *>(operator new(cap * sizeof(T)))) {}
+
+    ~Ringbuf()
+    {
+        for (i32 i = 0; i < cnt; i++) {
+            vals[phys(i)].~T();
+        }
+        operator delete(vals);
+        vals = nullptr;
+        head = 0;
+        cnt = 0;
+        cap = 0;
+    }
+
+    Ringbuf(const Ringbuf &other) = delete;
+    Ringbuf &operator=(const Ringbuf &other) = delete;
+
+    void push_back(const T &e)
+    {
+        grow();
+        new (vals + phys(cnt)) T(e);
+        cnt++;
+    }
+
+    void push_front(const T &e)
+    {
+        grow();
+        head = (head - 1) & (cap - 1);
+        new (vals + head) T(e);
+        cnt++;
+    }
+
+    void pop_back()
+    {
+        cnt--;
+        vals[phys(cnt)].~T();
+    }
+
+    void pop_front()
+    {
+        vals[head].~T();
+        head = (head + 1) & (cap - 1);
+        cnt--;
+    }
+
+    i32 len() const
+    {
+        return cnt;
+    }
+
+    T &operator[](const i32 idx)
+    {
+        return vals[phys(idx)];
+    }
+
+    const T &operator[](const i32 idx) const
+    {
+        return vals[phys(idx)];
+    }
+};
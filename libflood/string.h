@@ -30,6 +30,9 @@ public:
         hash_ = 0;
     }
 
+    // placeholder without storage, must be assigned before use
+    String() : cnt(1), cap(0), chars_(nullptr), hash_(0) {}
+
     String(const char *chars)
         : cnt(strlen(chars) + 1), cap(cnt), chars_(new char[cap]), hash_(hash_string(chars, cnt - 1))
     {
@@ -43,6 +46,13 @@ public:
         chars_[span.len] = '\0';
     }
 
+    String(const char *chars, const i32 len)
+        : cnt(len + 1), cap(cnt), chars_(new char[cap]), hash_(hash_string(chars, len))
+    {
+        memcpy(chars_, chars, len);
+        chars_[len] = '\0';
+    }
+
     String(const String &other) : cnt(other.cnt), cap(other.cap), chars_(new char[cap]), hash_(other.hash_)
     {
         strcpy(chars_, other.chars_);
@@ -0,0 +1,452 @@
+#include "aot.h"
+#include "optimize.h"
+#include "parse.h"
+#include "sema.h"
+#include <ctype.h>
+#include <limits.h> // for PATH_MAX
+#include <spawn.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h> // for getenv()
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h> // for getpid(), isatty()
+
+extern char **environ;
+
+// FLOOD_CXX, FLOOD_CXX_FLAGS, FLOOD_SOURCE_DIR and FLOOD_RUNTIME are defined by CMakeLists.txt, they are the compiler
+// of this build, its flags, the root of the source tree and the runtime library the executable is linked with. the
+// environment variables FLOOD_CXX, FLOOD_SOURCE_DIR and FLOOD_RUNTIME override them, so a build directory that was
+// moved can still be used
+
+static const char *setting(const char *name, const char *fallback)
+{
+    const char *val = getenv(name);
+    return val && val[0] ? val : fallback;
+}
+
+// the runtime next to the running executable, which is where the build puts it, or else the one this build made
+static const char *runtime_path(char *buf, const u64 size)
+{
+    if (const char *runtime = setting("FLOOD_RUNTIME", nullptr))
+        return runtime;
+    const ssize_t len = readlink("/proc/self/exe", buf, size - 1);
+    if (len > 0) {
+        buf[len] = '\0';
+        char *slash = strrchr(buf, '/');
+        const char *name = strrchr(FLOOD_RUNTIME, '/');
+        if (slash && name && (slash - buf) + strlen(name) < size) {
+            strcpy(slash, name);
+            if (access(buf, R_OK) == 0)
+                return buf;
+        }
+    }
+    return FLOOD_RUNTIME;
+}
+
+// hash of the code of fn, which aot_main checks to make sure the module compiled the same way
+static u32 code_hash(const FnObj &fn)
+{
+    return hash_string(reinterpret_cast<const char *>(fn.chunk.instrs()), fn.chunk.instrs_len());
+}
+
+// the fns of the module in the order aot_build and aot_main number them: the fns of the globals in order, the methods
+// of a class in the order of its table, each fn followed by the fns among its constants
+static void collect_fn(FnObj &fn, Dynarr<FnObj *> &fns)
+{
+    fns.push(&fn);
+    const Dynarr<Value> &constants = fn.chunk.constants();
+    for (i32 i = 0; i < constants.len(); i++) {
+        if (IS_FN(constants[i]))
+            collect_fn(*AS_FN(constants[i]), fns);
+    }
+}
+
+static void collect_fns(VM &vm, Dynarr<FnObj *> &fns)
+{
+    for (i32 i = 0; i < vm.globals.len(); i++) {
+        const Value val = vm.globals[i];
+        if (IS_CLOSURE(val)) {
+            collect_fn(*AS_CLOSURE(val)->fn, fns);
+        } else if (IS_CLASS(val)) {
+            ValTable &methods = AS_CLASS(val)->methods;
+            for (i32 j = 0; j < methods.cap(); j++) {
+                if (methods.slot(j).key && IS_CLOSURE(methods.slot(j).val))
+                    collect_fn(*AS_CLOSURE(methods.slot(j).val)->fn, fns);
+            }
+        }
+    }
+}
+
+// text of the translation unit
+struct Unit {
+    Dynarr<char> text;
+
+    __attribute__((format(printf, 2, 3))) void line(const char *format, ...)
+    {
+        char buf[256];
+        va_list args;
+        va_start(args, format);
+        const i32 len = vsnprintf(buf, sizeof(buf), format, args);
+        va_end(args);
+        for (i32 i = 0; i < len && i < i32(sizeof(buf)) - 1; i++)
+            text.push(buf[i]);
+        text.push('\n');
+    }
+
+    void blank()
+    {
+        text.push('\n');
+    }
+
+    void append(const Unit &other)
+    {
+        for (i32 i = 0; i < other.text.len(); i++)
+            text.push(other.text[i]);
+    }
+
+    void bytes(const char *data, const u64 len)
+    {
+        for (u64 i = 0; i < len; i += 16) {
+            char buf[128];
+            i32 pos = 0;
+            for (u64 j = i; j < len && j < i + 16; j++)
+                pos += snprintf(buf + pos, sizeof(buf) - pos, "%d,", data[j]);
+            line("    %s", buf);
+        }
+    }
+};
+
+// an instruction that calls a helper, see jit.h
+static void helper(Unit &unit, const char *name, const i32 offset, const i32 effect)
+{
+    unit.line("    if (!%s(vm, frame, sp, code + %d))", name, offset);
+    unit.line("        return JIT_ERR;");
+    if (effect != 0)
+        unit.line("    sp += %d;", effect);
+}
+
+// reports message unless sp[-1] is a number or a bool, ip is the ip run_vm reports it with
+static void check_top(Unit &unit, const char *is, const i32 ip, const char *message)
+{
+    unit.line("    if (!%s(sp[-1])) {", is);
+    unit.line("        runtime_err(code + %d, vm, \"%s\");", ip, message);
+    unit.line("        return JIT_ERR;");
+    unit.line("    }");
+}
+
+// the result of op on the numbers sp[-2] and sp[-1], for op in OP_ADD..OP_NEQ
+static void number_expr(char (&buf)[128], const OpCode op)
+{
+    static const char *const ops[] = {"+", "-", "*", "/", "", "", "<", "<=", ">", ">=", "==", "!="};
+    if (op == OP_FLOORDIV)
+        snprintf(buf, sizeof(buf), "MK_NUM(floor(AS_NUM(sp[-2]) / AS_NUM(sp[-1])))");
+    else if (op == OP_MOD)
+        snprintf(buf, sizeof(buf), "MK_NUM(fmod(AS_NUM(sp[-2]), AS_NUM(sp[-1])))");
+    else
+        snprintf(buf, sizeof(buf), "%s(AS_NUM(sp[-2]) %s AS_NUM(sp[-1]))", op <= OP_DIV ? "MK_NUM" : "MK_BOOL",
+                 ops[op - OP_ADD]);
+}
+
+// the name of the native fn of the ith fn of the module, which is the symbol perf and debuggers show for it
+static void fn_symbol(char (&buf)[128], const FnObj &fn, const i32 idx)
+{
+    i32 pos = snprintf(buf, sizeof(buf), "fn%d_", idx);
+    const char *name = fn.name->str.chars();
+    for (i32 i = 0; name[i] && pos < i32(sizeof(buf)) - 1; i++)
+        buf[pos++] = isalnum(name[i]) ? name[i] : '_';
+    buf[pos] = '\0';
+}
+
+// writes fn as the c++ fn named by fn_symbol. the instructions are the same as the jit compiles, with the same stack
+// effects. returns false if fn has an instruction that is not compiled
+static bool emit_fn(Unit &unit, FnObj &fn, const i32 idx)
+{
+    const Chunk &chunk = fn.chunk;
+    const u8 *code = chunk.instrs();
+    const i32 len = chunk.instrs_len();
+    // the instructions jumped to are labelled
+    Dynarr<bool> targets;
+    for (i32 i = 0; i <= len; i++)
+        targets.push(false);
+    for (i32 offset = 0; offset < len; offset += instr_len(code + offset)) {
+        const u8 *instr = code + offset;
+        if (*instr == OP_JUMP || *instr == OP_JUMP_IF_FALSE || *instr == OP_JUMP_IF_TRUE) {
+            const i32 target = offset + 3 + ((instr[1] << 8) | instr[2]);
+            if (target > len)
+                return false;
+            targets[target] = true;
+        }
+    }
+
+    char symbol[128];
+    fn_symbol(symbol, fn, idx);
+    unit.line("static JitStatus %s(VM &vm, CallFrame *frame, Value *bp, Value *sp)", symbol);
+    unit.line("{");
+    unit.line("    const u8 *code = frame->closure->fn->chunk.instrs();");
+    unit.line("    const Value *k = frame->closure->fn->chunk.constants().raw();");
+    unit.line("    (void)k;");
+    unit.line("    frame->bp = bp;");
+    for (i32 offset = 0; offset < len; offset += instr_len(code + offset)) {
+        const u8 *instr = code + offset;
+        const i32 ip = offset + instr_len(instr);
+        char expr[128];
+        if (targets[offset])
+            unit.line("L%d:", offset);
+        switch (*instr) {
+        case OP_NULL: unit.line("    *sp++ = MK_NULL;"); break;
+        case OP_TRUE: unit.line("    *sp++ = MK_BOOL(true);"); break;
+        case OP_FALSE: unit.line("    *sp++ = MK_BOOL(false);"); break;
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_LT:
+        case OP_LEQ:
+        case OP_GT:
+        case OP_GEQ: {
+            number_expr(expr, OpCode(*instr));
+            unit.line("    if (IS_NUM(sp[-2]) && IS_NUM(sp[-1]))");
+            unit.line("        sp[-2] = %s;", expr);
+            unit.line("    else if (!jit_binary(vm, frame, sp, code + %d))", offset);
+            unit.line("        return JIT_ERR;");
+            unit.line("    sp--;");
+            break;
+        }
+        case OP_ADD_NUM:
+        case OP_SUB_NUM:
+        case OP_MUL_NUM:
+        case OP_DIV_NUM:
+        case OP_FLOORDIV_NUM:
+        case OP_MOD_NUM:
+        case OP_LT_NUM:
+        case OP_LEQ_NUM:
+        case OP_GT_NUM:
+        case OP_GEQ_NUM:
+        case OP_EQEQ_NUM:
+        case OP_NEQ_NUM: {
+            number_expr(expr, OpCode(*instr - OP_ADD_NUM + OP_ADD));
+            unit.line("    sp[-2] = %s;", expr);
+            unit.line("    sp--;");
+            break;
+        }
+        case OP_FLOORDIV:
+        case OP_MOD:
+        case OP_EQEQ:
+        case OP_NEQ: helper(unit, "jit_binary", offset, -1); break;
+        case OP_NEGATE: {
+            check_top(unit, "IS_NUM", ip, "operand must be number");
+            unit.line("    sp[-1] = MK_NUM(-AS_NUM(sp[-1]));");
+            break;
+        }
+        case OP_NOT: {
+            check_top(unit, "IS_BOOL", ip, "operand must be boolean");
+            unit.line("    sp[-1] = MK_BOOL(!AS_BOOL(sp[-1]));");
+            break;
+        }
+        case OP_LIST: helper(unit, "jit_list", offset, 1 - instr[1]); break;
+        case OP_LIST_LONG: helper(unit, "jit_list", offset, 1 - ((instr[1] << 8) | instr[2])); break;
+        case OP_LIST_CONST: helper(unit, "jit_list_const", offset, 1); break;
+        case OP_HEAPVAL: helper(unit, "jit_heapval", offset, 0); break;
+        case OP_CLOSURE: helper(unit, "jit_closure", offset, 0); break;
+        case OP_GET_CONST: {
+            const Value val = chunk.constants()[instr[1]];
+            if (IS_NUM(val)) {
+                // the bits of the number, so it is not rounded by printing it
+                u64 bits;
+                memcpy(&bits, &AS_NUM(val), sizeof(bits));
+                unit.line("    *sp++ = MK_NUM(num(0x%llxull));", static_cast<unsigned long long>(bits));
+            } else if (IS_BOOL(val)) {
+                unit.line("    *sp++ = MK_BOOL(%s);", AS_BOOL(val) ? "true" : "false");
+            } else if (IS_NULL(val)) {
+                unit.line("    *sp++ = MK_NULL;");
+            } else {
+                unit.line("    *sp++ = k[%d];", instr[1]);
+            }
+            break;
+        }
+        case OP_GET_LOCAL: unit.line("    *sp++ = bp[%d];", instr[1]); break;
+        case OP_SET_LOCAL: unit.line("    bp[%d] = sp[-1];", instr[1]); break;
+        case OP_GET_HEAPVAL: helper(unit, "jit_get_heapval", offset, 1); break;
+        case OP_SET_HEAPVAL: helper(unit, "jit_set_heapval", offset, 0); break;
+        case OP_GET_CAPTURED: helper(unit, "jit_get_captured", offset, 1); break;
+        case OP_SET_CAPTURED: helper(unit, "jit_set_captured", offset, 0); break;
+        case OP_GET_GLOBAL: helper(unit, "jit_get_global", offset, 1); break;
+        case OP_SET_GLOBAL: helper(unit, "jit_set_global", offset, 0); break;
+        case OP_GET_SUBSCR:
+        case OP_GET_SUBSCR_LIST: helper(unit, "jit_get_subscr", offset, -1); break;
+        case OP_SET_SUBSCR:
+        case OP_SET_SUBSCR_LIST: helper(unit, "jit_set_subscr", offset, -2); break;
+        case OP_GET_FIELD:
+        case OP_GET_FIELD_CACHED: helper(unit, "jit_get_field", offset, 0); break;
+        case OP_SET_FIELD:
+        case OP_SET_FIELD_CACHED: helper(unit, "jit_set_field", offset, -1); break;
+        case OP_GET_METHOD: helper(unit, "jit_get_method", offset, 0); break;
+        case OP_JUMP: unit.line("    goto L%d;", offset + 3 + ((instr[1] << 8) | instr[2])); break;
+        case OP_JUMP_IF_FALSE:
+        case OP_JUMP_IF_TRUE: {
+            check_top(unit, "IS_BOOL", ip, "operand must be boolean");
+            unit.line("    if (%sAS_BOOL(sp[-1]))", *instr == OP_JUMP_IF_FALSE ? "!" : "");
+            unit.line("        goto L%d;", offset + 3 + ((instr[1] << 8) | instr[2]));
+            break;
+        }
+        case OP_CALL: {
+            unit.line("    if (const JitStatus status = jit_call(vm, frame, sp, code + %d); status != JIT_RETURN)",
+                      offset);
+            unit.line("        return status;");
+            unit.line("    sp -= %d;", instr[1]);
+            break;
+        }
+        case OP_RETURN: {
+            unit.line("    bp[-1] = sp[-1];");
+            unit.line("    return JIT_RETURN;");
+            break;
+        }
+        case OP_POP: unit.line("    sp--;"); break;
+        case OP_POP_N: unit.line("    sp -= %d;", instr[1]); break;
+        case OP_PRINT: helper(unit, "jit_print", offset, -1); break;
+        default: return false;
+        }
+    }
+    if (targets[len])
+        unit.line("L%d:", len);
+    unit.line("    __builtin_unreachable();");
+    unit.line("}");
+    unit.blank();
+    return true;
+}
+
+// runs the c++ compiler on the translation unit at unit_path
+static bool compile_unit(const char *unit_path, const char *path)
+{
+    const char *cxx = setting("FLOOD_CXX", FLOOD_CXX);
+    char flags[] = FLOOD_CXX_FLAGS;
+    char include[PATH_MAX];
+    if (snprintf(include, sizeof(include), "-I%s/src", setting("FLOOD_SOURCE_DIR", FLOOD_SOURCE_DIR)) >=
+        i32(sizeof(include)))
+        return false;
+    char runtime[PATH_MAX];
+    Dynarr<const char *> args;
+    args.push(cxx);
+    args.push("-std=c++20");
+    args.push("-O2");
+    args.push("-w");
+    args.push(include);
+    for (char *flag = strtok(flags, " "); flag; flag = strtok(nullptr, " "))
+        args.push(flag);
+    args.push(unit_path);
+    args.push(runtime_path(runtime, sizeof(runtime)));
+    args.push("-lm");
+    args.push("-o");
+    args.push(path);
+    args.push(nullptr);
+    pid_t pid;
+    i32 status = 0;
+    return posix_spawnp(&pid, cxx, nullptr, nullptr, const_cast<char **>(args.raw()), environ) == 0 &&
+           waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+bool aot_build(VM &vm, const char *source, const u64 len, const CompileOptions &options, const char *path)
+{
+    char unit_path[PATH_MAX];
+    if (snprintf(unit_path, sizeof(unit_path), "%s.%d.cc", path, getpid()) >= i32(sizeof(unit_path)))
+        return false;
+    Dynarr<FnObj *> fns;
+    collect_fns(vm, fns);
+
+    Unit unit;
+    unit.line("#include \"aot.h\"");
+    unit.line("#include <math.h>");
+    unit.line("#include <string.h>");
+    unit.blank();
+    unit.line("static inline double num(const u64 bits)");
+    unit.line("{");
+    unit.line("    double number;");
+    unit.line("    memcpy(&number, &bits, sizeof(number));");
+    unit.line("    return number;");
+    unit.line("}");
+    unit.blank();
+    Dynarr<bool> compiled;
+    for (i32 i = 0; i < fns.len(); i++) {
+        Unit fn_unit;
+        compiled.push(emit_fn(fn_unit, *fns[i], i));
+        if (compiled[i])
+            unit.append(fn_unit);
+    }
+    // each array has a last element of its own, so none is empty
+    unit.line("static const JitFn fns[] = {");
+    for (i32 i = 0; i < fns.len(); i++) {
+        char symbol[128];
+        fn_symbol(symbol, *fns[i], i);
+        unit.line("    %s,", compiled[i] ? symbol : "nullptr");
+    }
+    unit.line("    nullptr};");
+    unit.line("static const u32 code_hashes[] = {");
+    for (i32 i = 0; i < fns.len(); i++)
+        unit.line("    %uu,", code_hash(*fns[i]));
+    unit.line("    0};");
+    unit.line("static const char source[] = {");
+    unit.bytes(source, len);
+    unit.line("    0};");
+    unit.blank();
+    unit.line("int main()");
+    unit.line("{");
+    unit.line("    CompileOptions options;");
+    unit.line("    options.peephole = %s;", options.peephole ? "true" : "false");
+    unit.line("    options.inline_threshold = %d;", options.inline_threshold);
+    unit.line("    return aot_main(source, %llu, options, fns, code_hashes, %d);", static_cast<unsigned long long>(len),
+              fns.len());
+    unit.line("}");
+
+    FILE *fp = fopen(unit_path, "wb");
+    if (!fp)
+        return false;
+    const bool written = fwrite(unit.text.raw(), 1, unit.text.len(), fp) == u64(unit.text.len());
+    const bool ok = fclose(fp) == 0 && written && compile_unit(unit_path, path);
+    remove(unit_path);
+    return ok;
+}
+
+i32 aot_main(const char *source, const u64 len, const CompileOptions &options, const JitFn *fns, const u32 *code_hashes,
+             const i32 fn_cnt)
+{
+    // the scanner may look at the bytes around the source, see main
+    char *buf = new char[len + 2 + SCAN_PADDING];
+    buf[0] = '\0';
+    memcpy(buf + 1, source, len);
+    memset(buf + len + 1, 0, 1 + SCAN_PADDING);
+
+    VM vm;
+    ClosureObj *script = nullptr;
+    {
+        // the ast is released before main runs
+        Dynarr<ErrMsg> errarr;
+        Arena arena;
+        ModuleNode &node = parse(buf + 1, arena, errarr);
+        if (errarr.len() == 0)
+            analyze(node, vm, errarr, arena);
+        if (errarr.len() == 0) {
+            optimize(node, arena);
+            script = compile(vm, node, errarr, options);
+        }
+        if (errarr.len() > 0) {
+            print_errarr(errarr, isatty(1));
+            delete[] buf;
+            return 1;
+        }
+    }
+
+    Dynarr<FnObj *> module_fns;
+    collect_fns(vm, module_fns);
+    bool same = module_fns.len() == fn_cnt;
+    for (i32 i = 0; same && i < fn_cnt; i++)
+        same = code_hash(*module_fns[i]) == code_hashes[i];
+    // otherwise the jit compiles the fns as they are called
+    for (i32 i = 0; same && i < fn_cnt; i++)
+        module_fns[i]->jit = fns[i];
+    vm.jit = true;
+    if (script)
+        run_vm(vm, *script);
+    delete[] buf;
+    return 0;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "compile.h"
+#include "jit.h"
+
+// NOTE:
+// ahead of time compilation to an executable through the system c++ compiler. each fn of a compiled module becomes a
+// c++ fn with the signature of native code of the jit (see jit.h): the fast paths of arithmetic and jumps are written
+// out so the c++ compiler can allocate registers across them, every other instruction calls the helper the jit
+// calls. the executable is linked with the runtime of this build, and holds the source of the module and the
+// options it was compiled with. on start it compiles the module like flood does, which gives the same fns in the
+// same order, so each native fn is attached to the fn it was generated from before main runs
+
+// writes the translation unit for the module vm compiled from source with options and builds it into an executable
+// at path. returns false if the executable could not be built
+bool aot_build(VM &vm, const char *source, const u64 len, const CompileOptions &options, const char *path);
+
+// entry point of an executable built by aot_build. fns[i] is the native fn of the ith fn of the module, or nullptr if
+// it has an instruction that is not compiled, and code_hashes[i] the hash of its code, which is checked to make sure
+// the module compiled the same way. returns the exit status
+i32 aot_main(const char *source, const u64 len, const CompileOptions &options, const JitFn *fns,
+             const u32 *code_hashes, const i32 fn_cnt);
@@ -1,12 +1,16 @@
 #pragma once
 #include "scan.h"
+#include <stdlib.h>
 #define MAX_LOCALS    (256)
 #define FLAG_NONE     (0)
 #define FLAG_CAPTURED (1 << 1)
 #define FLAG_METHOD   (1 << 2)
 #define FLAG_INIT     (1 << 3)
+#define FLAG_ASSIGNED (1 << 4) // variable is the target of an assignment
+#define FLAG_NUM      (1 << 5) // variable or param only ever holds numbers, see sema.cc
+#define FLAG_RET_NUM  (1 << 6) // fn only ever returns numbers, see sema.cc
 
-enum NodeTag {
+enum NodeTag : u8 {
     NODE_ATOM,
     NODE_LIST,
     NODE_IDENT,
@@ -30,10 +34,9 @@ enum NodeTag {
     NODE_MODULE
 };
 
-// TODO replace this shit with slices where needed
-
 struct BlockNode;
 
+// fields narrower than a pointer come first in each node, so they fill the padding after tag
 struct Node {
     const Span span;
     const NodeTag tag;
@@ -42,19 +45,25 @@ struct Node {
 
 struct AtomNode : public Node {
     const TokenTag atom_tag;
-    AtomNode(const Span span, const TokenTag atom_tag) : Node(span, NODE_ATOM), atom_tag(atom_tag) {}
+    const double num; // value of a TOKEN_NUMBER atom, parsed once
+    AtomNode(const Span span, const TokenTag atom_tag)
+        : Node(span, NODE_ATOM), atom_tag(atom_tag), num(atom_tag == TOKEN_NUMBER ? strtod(span.start, nullptr) : 0)
+    {
+    }
+    // number computed at compile time, span is the expression it replaces
+    AtomNode(const Span span, const double num) : Node(span, NODE_ATOM), atom_tag(TOKEN_NUMBER), num(num) {}
 };
 
 struct ListNode : public Node {
     // span is `[`
-    Node *const *const items;
     const i32 cnt;
-    ListNode(const Span span, Node *const *const items, const i32 cnt) : Node(span, NODE_LIST), items(items), cnt(cnt)
+    Node **const items;
+    ListNode(const Span span, Node **const items, const i32 cnt) : Node(span, NODE_LIST), cnt(cnt), items(items)
     {
     }
 };
 
-enum LocTag { LOC_LOCAL, LOC_GLOBAL, LOC_STACK_HEAPVAL, LOC_CAPTURED_HEAPVAL };
+enum LocTag : u8 { LOC_LOCAL, LOC_GLOBAL, LOC_STACK_HEAPVAL, LOC_CAPTURED_HEAPVAL };
 
 struct Loc {
     LocTag tag;
@@ -71,77 +80,77 @@ struct IdentNode : public Node {
 
 struct UnaryNode : public Node {
     // span is op
-    Node *const rhs;
     const TokenTag op_tag;
+    Node *rhs;
     UnaryNode(const Span span, Node *const rhs, const TokenTag op_tag)
-        : Node(span, NODE_UNARY), rhs(rhs), op_tag(op_tag)
+        : Node(span, NODE_UNARY), op_tag(op_tag), rhs(rhs)
     {
     }
 };
 
 struct BinaryNode : public Node {
     // span is op
-    Node *const lhs;
-    Node *const rhs;
     const TokenTag op_tag;
+    Node *lhs;
+    Node *rhs;
     BinaryNode(const Span span, Node *const lhs, Node *const rhs, const TokenTag op_tag)
-        : Node(span, NODE_BINARY), lhs(lhs), rhs(rhs), op_tag(op_tag)
+        : Node(span, NODE_BINARY), op_tag(op_tag), lhs(lhs), rhs(rhs)
     {
     }
 };
 
 struct SelectorNode : public Node {
     // span is `.` or `:`
-    Node *const lhs;
+    const TokenTag op_tag;
+    Node *lhs;
     //      foo.bar
     //          ^~~ sym
     const Span sym;
-    const TokenTag op_tag;
     SelectorNode(const Span span, Node *const lhs, const Span sym, const TokenTag op_tag)
-        : Node(span, NODE_SELECTOR), lhs(lhs), sym(sym), op_tag(op_tag)
+        : Node(span, NODE_SELECTOR), op_tag(op_tag), lhs(lhs), sym(sym)
     {
     }
 };
 
 struct SubscrNode : public Node {
     // span is `[`
-    Node *const lhs;
-    Node *const rhs;
+    Node *lhs;
+    Node *rhs;
     SubscrNode(const Span span, Node *const lhs, Node *const rhs) : Node(span, NODE_SUBSCR), lhs(lhs), rhs(rhs) {}
 };
 
 struct AssignNode : public Node {
     // span is `=`, `+=`, `-=`, `*=`, `/=`, `//=`, `%=`
-    Node *const lhs;
-    Node *const rhs;
     const TokenTag op_tag;
+    Node *const lhs;
+    Node *rhs;
     AssignNode(const Span span, Node *const lhs, Node *const rhs, const TokenTag op_tag)
-        : Node(span, NODE_ASSIGN), lhs(lhs), rhs(rhs), op_tag(op_tag)
+        : Node(span, NODE_ASSIGN), op_tag(op_tag), lhs(lhs), rhs(rhs)
     {
     }
 };
 
 struct CallNode : public Node {
     // span is `(`
-    Node *const lhs;
-    Node *const *const args;
     const i32 arity;
-    CallNode(const Span span, Node *const lhs, Node *const *const args, const i32 arity)
-        : Node(span, NODE_CALL), lhs(lhs), args(args), arity(arity)
+    Node *lhs;
+    Node **const args;
+    CallNode(const Span span, Node *const lhs, Node **const args, const i32 arity)
+        : Node(span, NODE_CALL), arity(arity), lhs(lhs), args(args)
     {
     }
 };
 
 struct DeclNode : public Node {
+    u8 flags;
     i32 fn_depth;
-    u32 flags;
     Loc loc;
-    DeclNode(const Span span, const NodeTag tag) : Node(span, tag), fn_depth(0), flags(FLAG_NONE){};
+    DeclNode(const Span span, const NodeTag tag) : Node(span, tag), flags(FLAG_NONE), fn_depth(0){};
 };
 
 struct VarDeclNode : public DeclNode {
     // span is identifier
-    Node *const init;
+    Node *init;
     VarDeclNode(const Span span, Node *const init) : DeclNode(span, NODE_VAR_DECL), init(init) {}
 };
 
@@ -155,11 +164,11 @@ struct FnDeclNode : public DeclNode {
     // span is identifier
     BlockNode *const body;
     VarDeclNode *const params;
+    CaptureDecl **captures; // set by analyze, see sema.cc
     const i32 arity;
     i32 capture_cnt;
-    CaptureDecl *captures[MAX_LOCALS];
     FnDeclNode(const Span span, BlockNode *const body, VarDeclNode *const params, const i32 arity)
-        : DeclNode(span, NODE_FN_DECL), body(body), params(params), arity(arity), capture_cnt(0), captures{}
+        : DeclNode(span, NODE_FN_DECL), body(body), params(params), captures(nullptr), arity(arity), capture_cnt(0)
     {
     }
 };
@@ -177,31 +186,31 @@ struct ClassDeclNode : public DeclNode {
 // TEMP remove when we add functions
 struct PrintNode : public Node {
     // span is `print`
-    Node *const expr;
+    Node *expr;
     PrintNode(const Span span, Node *const expr) : Node(span, NODE_PRINT), expr(expr) {}
 };
 
 struct ExprStmtNode : public Node {
     // span is `;`
-    Node *const expr;
+    Node *expr;
     ExprStmtNode(const Span span, Node *const expr) : Node(span, NODE_EXPR_STMT), expr(expr) {}
 };
 
 struct BlockNode : public Node {
     // span is `{`
-    Node *const *const stmts;
-    const i32 cnt;
     const bool is_fn_body;
+    const i32 cnt;
+    Node **const stmts;
     i32 local_cnt; // locals declared in block, including params if block is fn body
-    BlockNode(const Span span, Node *const *const stmts, const i32 cnt, const bool is_fn_body)
-        : Node(span, NODE_BLOCK), stmts(stmts), cnt(cnt), is_fn_body(is_fn_body), local_cnt(0)
+    BlockNode(const Span span, Node **const stmts, const i32 cnt, const bool is_fn_body)
+        : Node(span, NODE_BLOCK), is_fn_body(is_fn_body), cnt(cnt), stmts(stmts), local_cnt(0)
     {
     }
 };
 
 struct IfNode : public Node {
     // span is `if`
-    Node *const cond;
+    Node *cond;
     BlockNode *const thn;
     BlockNode *const els;
     IfNode(const Span span, Node *const cond, BlockNode *const thn, BlockNode *const els)
@@ -212,7 +221,7 @@ struct IfNode : public Node {
 
 struct ReturnNode : public Node {
     // span is `return`
-    Node *const expr;
+    Node *expr;
     ReturnNode(const Span span, Node *const expr) : Node(span, NODE_RETURN), expr(expr) {}
 };
 
@@ -229,10 +238,10 @@ struct ImportNode : public DeclNode {
 
 struct ModuleNode : public Node {
     // span is filename
-    DeclNode *const *const decls;
     const i32 cnt;
+    DeclNode *const *const decls;
     ModuleNode(const Span span, DeclNode *const *const decls, const i32 cnt)
-        : Node(span, NODE_MODULE), decls(decls), cnt(cnt)
+        : Node(span, NODE_MODULE), cnt(cnt), decls(decls)
     {
     }
 };
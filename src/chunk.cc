@@ -16,3 +16,55 @@ i32 Chunk::add_constant(const Value val)
     constants_.push(val);
     return constants_.len() - 1;
 }
+
+FieldCache &Chunk::field_cache(const i32 const_idx)
+{
+    while (field_caches_.len() <= const_idx)
+        field_caches_.push(FieldCache());
+    return field_caches_[const_idx];
+}
+
+void Chunk::map_code(const u8 *code, const i32 len, Dynarr<i32> &&lines)
+{
+    mapped_code_ = code;
+    mapped_len_ = len;
+    lines_ = move(lines);
+}
+
+void Chunk::clear_code()
+{
+    lines_ = Dynarr<i32>();
+    code_ = Dynarr<u8>();
+}
+
+i32 instr_len(const u8 *code)
+{
+    switch (code[0]) {
+    case OP_LIST:
+    case OP_LIST_CONST:
+    case OP_HEAPVAL:
+    case OP_GET_CONST:
+    case OP_GET_LOCAL:
+    case OP_SET_LOCAL:
+    case OP_GET_HEAPVAL:
+    case OP_SET_HEAPVAL:
+    case OP_GET_CAPTURED:
+    case OP_SET_CAPTURED:
+    case OP_GET_GLOBAL:
+    case OP_SET_GLOBAL:
+    case OP_GET_FIELD:
+    case OP_SET_FIELD:
+    case OP_GET_FIELD_CACHED:
+    case OP_SET_FIELD_CACHED:
+    case OP_GET_METHOD:
+    case OP_CALL:
+    case OP_POP_N: return 2;
+    case OP_LIST_LONG:
+    case OP_JUMP:
+    case OP_JUMP_IF_FALSE:
+    case OP_JUMP_IF_TRUE: return 3;
+    // args: n, then n pairs of loc tag and idx
+    case OP_CLOSURE: return 2 + 2 * code[1];
+    default: return 1;
+    }
+}
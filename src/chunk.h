@@ -23,8 +23,23 @@ enum OpCode {
     OP_NEGATE,
     OP_NOT,
 
-    // TODO make OP_LIST_LONG which can more elems
-    OP_LIST, // args: n 0..=255
+    // unchecked variants of OP_ADD..OP_NEQ in the same order, emitted when sema proves both operands are numbers
+    OP_ADD_NUM,
+    OP_SUB_NUM,
+    OP_MUL_NUM,
+    OP_DIV_NUM,
+    OP_FLOORDIV_NUM,
+    OP_MOD_NUM,
+    OP_LT_NUM,
+    OP_LEQ_NUM,
+    OP_GT_NUM,
+    OP_GEQ_NUM,
+    OP_EQEQ_NUM,
+    OP_NEQ_NUM,
+
+    OP_LIST,       // args: n 0..=255
+    OP_LIST_LONG,  // args: hi, lo of n 0..=65535
+    OP_LIST_CONST, // args: 0..=255 idx into constant arr of a list that is copied
     // args: n 0..=255, then n indices 0..=255 offset from bp
     // then  m 0..=255, then m indices 0..=255 idx into capture arr
     OP_HEAPVAL, // args: 0..=255 offset from bp
@@ -50,6 +65,13 @@ enum OpCode {
 
     OP_GET_METHOD, // args: 0..=255 idx into constant arr
 
+    // quickened forms, see run_vm. the generic instruction rewrites itself into one of these after it succeeds on
+    // a list or an instance, and they rewrite themselves back when their guard fails
+    OP_GET_SUBSCR_LIST,
+    OP_SET_SUBSCR_LIST,
+    OP_GET_FIELD_CACHED, // args: 0..=255 idx into constant arr
+    OP_SET_FIELD_CACHED, // args: 0..=255 idx into constant arr
+
     OP_JUMP,
     OP_JUMP_IF_FALSE,
     OP_JUMP_IF_TRUE,
@@ -62,6 +84,78 @@ enum OpCode {
     OP_PRINT,
 };
 
+// three-address instruction set of the register interpreter, see regcompile.cc and regvm.cc.
+// a, b and c are registers, i.e. slots relative to bp. locals live in the same slots as with the stack
+// instruction set, temporaries are allocated above them
+enum RegOpCode {
+    REG_LOADNULL,  // args: a
+    REG_LOADTRUE,  // args: a
+    REG_LOADFALSE, // args: a
+    REG_LOADK,     // args: a, 0..=255 idx into constant arr
+    REG_MOVE,      // args: a, b
+
+    // args: a, b, c          a = b op c
+    REG_ADD,
+    REG_SUB,
+    REG_MUL,
+    REG_DIV,
+    REG_FLOORDIV,
+    REG_MOD,
+    REG_LT,
+    REG_LEQ,
+    REG_GT,
+    REG_GEQ,
+    REG_EQEQ,
+    REG_NEQ,
+    REG_NEGATE, // args: a, b
+    REG_NOT,    // args: a, b
+
+    REG_LIST,        // args: a, b, n         a = [b, b+1, ..., b+n-1]
+    REG_LIST_APPEND, // args: a, b, n         pushes b, b+1, ..., b+n-1 on the list a
+    REG_LIST_CONST,  // args: a, 0..=255 idx into constant arr of a list that is copied
+    REG_HEAPVAL, // args: a
+    // args: a, 0..=255 idx into constant arr, n, then n pairs of loc tag and idx
+    REG_CLOSURE,
+
+    REG_GET_HEAPVAL,  // args: a, b           a = *b
+    REG_SET_HEAPVAL,  // args: a, b           *a = b
+    REG_GET_CAPTURED, // args: a, 0..=255 idx into capture arr
+    REG_SET_CAPTURED, // args: 0..=255 idx into capture arr, b
+    REG_GET_GLOBAL,   // args: a, 0..=255 idx into global arr
+    REG_SET_GLOBAL,   // args: 0..=255 idx into global arr, b
+    REG_GET_SUBSCR,   // args: a, b, c        a = b[c]
+    REG_SET_SUBSCR,   // args: a, b, c        a[b] = c
+    REG_GET_FIELD,    // args: a, b, 0..=255 idx into constant arr
+    REG_SET_FIELD,    // args: a, 0..=255 idx into constant arr, c
+    REG_GET_METHOD,   // args: a, b, 0..=255 idx into constant arr
+
+    REG_JUMP,          // args: hi, lo
+    REG_JUMP_IF_FALSE, // args: a, hi, lo
+    REG_JUMP_IF_TRUE,  // args: a, hi, lo
+    // args: a, n. calls a with args a+1, ..., a+n and puts the result in a.
+    // the callee's bp is a+1, so its params are the args
+    REG_CALL,
+    REG_RETURN, // args: a
+
+    // TEMP remove when we add functions
+    REG_PRINT, // args: a
+};
+
+// inline cache of OP_GET_FIELD_CACHED and OP_SET_FIELD_CACHED: the slot of the instance's field table the field
+// was last found in, and the key in that slot. the gc keeps the key alive so that the pointer stays unique
+struct FieldCache {
+    StringObj *key = nullptr;
+    i32 slot = 0;
+};
+
+// code in [start, end) was inlined from the fn whose name is the constant name, called on line
+struct InlinedRange {
+    i32 start;
+    i32 end;
+    i32 name;
+    i32 line;
+};
+
 class Chunk {
     // NOTE:
     // representing line info
@@ -84,7 +178,13 @@ class Chunk {
     //      8       opcode cnt
     Dynarr<i32> lines_;
     Dynarr<u8> code_;
+    // code of a chunk read from an image, which is run in place, see serialize.h. code_ is empty if it is set
+    const u8 *mapped_code_ = nullptr;
+    i32 mapped_len_ = 0;
     Dynarr<Value> constants_;
+    Dynarr<FieldCache> field_caches_; // indexed by the constant idx of the field name
+    // ranges of nested inlined calls contain each other, and the inner range comes first
+    Dynarr<InlinedRange> inlined_;
 
 public:
     Dynarr<i32> const &lines() const
@@ -99,10 +199,39 @@ public:
     {
         return code_;
     }
+    // the code to run, which is either code() or lives in an image
+    const u8 *instrs() const
+    {
+        return mapped_code_ ? mapped_code_ : code_.raw();
+    }
+    i32 instrs_len() const
+    {
+        return mapped_code_ ? mapped_len_ : code_.len();
+    }
+    // run the code in place. it is rewritten by quickening, so it must be writable and outlive the chunk
+    void map_code(const u8 *code, const i32 len, Dynarr<i32> &&lines);
     Dynarr<Value> const &constants() const
     {
         return constants_;
     }
+    Dynarr<FieldCache> const &field_caches() const
+    {
+        return field_caches_;
+    }
+    FieldCache &field_cache(const i32 const_idx);
+    Dynarr<InlinedRange> const &inlined() const
+    {
+        return inlined_;
+    }
+    Dynarr<InlinedRange> &inlined()
+    {
+        return inlined_;
+    }
     void emit_byte(const u8 byte, const i32 line);
     i32 add_constant(const Value val);
+    // drops the code and line info but keeps the constants, so that optimized code can be emitted in its place
+    void clear_code();
 };
+
+// length in bytes of the instruction starting at code, including its args
+i32 instr_len(const u8 *code);
@@ -3,8 +3,9 @@
 #include "chunk.h"
 #include "gc.h"
 #include "object.h"
+#include "peephole.h"
+#include "sema.h"
 #include "value.h"
-#include <stdlib.h>
 
 static u8 desugar_assign(const TokenTag tag)
 {
@@ -19,18 +20,137 @@ static u8 desugar_assign(const TokenTag tag)
     }
 }
 
+// the unchecked variant of an arithmetic or comparison op if both operands are known to be numbers
+static u8 num_variant(const u8 op, const Node &lhs, const Node &rhs)
+{
+    if (is_num_expr(lhs) && is_num_expr(rhs))
+        return op + (OP_ADD_NUM - OP_ADD);
+    return op;
+}
+
+#define MAX_INLINE_DEPTH (4) // bounds the code growth of helpers that are inlined into each other
+
+// decides whether the body of a fn can be inlined at its call sites
+struct InlineCheck final : AstVisitor {
+    const FnDeclNode &callee;
+    const i32 threshold;
+    i32 size;     // ast nodes in the body, counting stops once the threshold is exceeded
+    i32 slot_cnt; // stack slots used by params and locals
+    bool ok;
+
+    InlineCheck(const FnDeclNode &callee, const i32 threshold)
+        : callee(callee), threshold(threshold), size(0), slot_cnt(callee.arity), ok(true)
+    {
+        visit_block(*callee.body);
+    }
+
+    bool count()
+    {
+        if (++size > threshold)
+            ok = false;
+        return ok;
+    }
+
+    void visit_expr(Node &node) override
+    {
+        if (count())
+            AstVisitor::visit_expr(node);
+    }
+
+    void visit_stmt(Node &node) override
+    {
+        if (count())
+            AstVisitor::visit_stmt(node);
+    }
+
+    void visit_ident(IdentNode &node) override
+    {
+        // a recursive fn would be inlined into itself
+        if (node.decl == &callee)
+            ok = false;
+    }
+
+    void visit_var_decl(VarDeclNode &node) override
+    {
+        AstVisitor::visit_var_decl(node);
+        if (node.loc.idx + 1 > slot_cnt)
+            slot_cnt = node.loc.idx + 1;
+    }
+
+    void visit_fn_decl(FnDeclNode &) override
+    {
+        // closures capture locals by their slot in the frame of the fn they are declared in
+        ok = false;
+    }
+};
+
+// the call being inlined. the args and locals of the callee live in the frame of the caller starting at base,
+// and the result is left in base
+struct InlineFrame {
+    FnDeclNode *callee;
+    i32 base;
+    Dynarr<i32> returns; // jumps from the returns of the callee to the end of the inlined body
+    InlineFrame *parent;
+};
+
+ListObj *const_list(VM &vm, const ListNode &node)
+{
+    if (node.cnt == 0)
+        return nullptr;
+    for (i32 i = 0; i < node.cnt; i++) {
+        if (node.items[i]->tag != NODE_ATOM)
+            return nullptr;
+    }
+    Dynarr<Value> vals;
+    for (i32 i = 0; i < node.cnt; i++) {
+        const AtomNode &atom = static_cast<const AtomNode &>(*node.items[i]);
+        // clang-format off
+        switch (atom.atom_tag) {
+        case TOKEN_NULL:   vals.push(MK_NULL); break;
+        case TOKEN_TRUE:   vals.push(MK_BOOL(true)); break;
+        case TOKEN_FALSE:  vals.push(MK_BOOL(false)); break;
+        case TOKEN_NUMBER: vals.push(MK_NUM(atom.num)); break;
+        case TOKEN_STRING: vals.push(MK_OBJ(alloc<StringObj>(vm, atom.span))); break;
+        default:           break; // the parser only makes atoms of the tokens above
+        }
+        // clang-format on
+    }
+    return alloc<ListObj>(vm, vals.raw(), vals.len());
+}
+
 struct Compiler final : AstVisitor {
     FnObj *fn;
     FnDeclNode *fn_node;
     VM &vm;
     Dynarr<ErrMsg> &errarr;
-    Compiler(VM &vm, Dynarr<ErrMsg> &errarr) : fn(nullptr), fn_node(nullptr), vm(vm), errarr(errarr) {}
+    const CompileOptions &options;
+    // values on the stack of the current frame, kept up to date so that inlined code knows where its locals go
+    i32 depth;
+    InlineFrame *inlining;
+    Compiler(VM &vm, Dynarr<ErrMsg> &errarr, const CompileOptions &options)
+        : fn(nullptr), fn_node(nullptr), vm(vm), errarr(errarr), options(options), depth(0), inlining(nullptr)
+    {
+    }
 
     Chunk &chunk()
     {
         return fn->chunk;
     }
 
+    void emit_pops(i32 n, const i32 line)
+    {
+        for (; n > 255; n -= 255) {
+            chunk().emit_byte(OP_POP_N, line);
+            chunk().emit_byte(255, line);
+        }
+        if (n == 1) {
+            chunk().emit_byte(OP_POP, line);
+        } else if (n > 1) {
+            chunk().emit_byte(OP_POP_N, line);
+            chunk().emit_byte(n, line);
+        }
+    }
+
     i32 emit_jump(const OpCode op, const i32 line)
     {
         const i32 offset = chunk().code().len();
@@ -69,7 +189,7 @@ struct Compiler final : AstVisitor {
         case TOKEN_NULL:   chunk().emit_byte(OP_NULL, line); break;
         case TOKEN_TRUE:   chunk().emit_byte(OP_TRUE, line); break;
         case TOKEN_FALSE:  chunk().emit_byte(OP_FALSE, line); break;
-        case TOKEN_NUMBER: emit_constant(MK_NUM(strtod(node.span.start, nullptr)), line); break;
+        case TOKEN_NUMBER: emit_constant(MK_NUM(node.num), line); break;
         case TOKEN_STRING: emit_constant(MK_OBJ(alloc<StringObj>(vm, node.span)), line); break;
         }
         // clang-format on
@@ -83,8 +203,9 @@ struct Compiler final : AstVisitor {
                       : node.decl->loc.tag == LOC_STACK_HEAPVAL ? get ? OP_GET_HEAPVAL : OP_SET_HEAPVAL
                                                           : get ? OP_GET_CAPTURED : OP_SET_CAPTURED;
         // clang-format on
+        const bool is_local = node.decl->loc.tag == LOC_LOCAL || node.decl->loc.tag == LOC_STACK_HEAPVAL;
         chunk().emit_byte(op, node.span.line);
-        chunk().emit_byte(node.decl->loc.idx, node.span.line);
+        chunk().emit_byte(node.decl->loc.idx + (inlining && is_local ? inlining->base : 0), node.span.line);
     }
 
     void visit_ident(IdentNode &node) override
@@ -94,13 +215,26 @@ struct Compiler final : AstVisitor {
 
     void visit_list(ListNode &node) override
     {
-        // TODO allow lists to be initialized with more than 256 elements
-        // TODO handle lists being initialized with too many elements
         const i32 line = node.span.line;
+        if (ListObj *tmpl = const_list(vm, node)) {
+            chunk().emit_byte(OP_LIST_CONST, line);
+            chunk().emit_byte(chunk().add_constant(MK_OBJ(tmpl)), line);
+            return;
+        }
+        if (node.cnt > (1 << 16) - 1) {
+            errarr.push({node.span, "too many elements in list"});
+            return;
+        }
         for (i32 i = 0; i < node.cnt; i++)
             visit_expr(*node.items[i]);
-        chunk().emit_byte(OP_LIST, line);
-        chunk().emit_byte(node.cnt, line);
+        if (node.cnt <= 255) {
+            chunk().emit_byte(OP_LIST, line);
+            chunk().emit_byte(node.cnt, line);
+        } else {
+            chunk().emit_byte(OP_LIST_LONG, line);
+            chunk().emit_byte((node.cnt >> 8) & 0xff, line);
+            chunk().emit_byte(node.cnt & 0xff, line);
+        }
     }
 
     void visit_unary(UnaryNode &node) override
@@ -121,28 +255,31 @@ struct Compiler final : AstVisitor {
             visit_expr(*node.lhs);
             const i32 offset = emit_jump(op_tag == TOKEN_AND ? OP_JUMP_IF_FALSE : OP_JUMP_IF_TRUE, line);
             chunk().emit_byte(OP_POP, line);
+            depth--;
             visit_expr(*node.rhs);
             patch_jump(node.span, offset);
             return;
         }
         visit_expr(*node.lhs);
         visit_expr(*node.rhs);
+        u8 op = 0;
         // clang-format off
         switch (op_tag) {
-        case TOKEN_PLUS:        chunk().emit_byte(OP_ADD, line); break;
-        case TOKEN_MINUS:       chunk().emit_byte(OP_SUB, line); break;
-        case TOKEN_STAR:        chunk().emit_byte(OP_MUL, line); break;
-        case TOKEN_SLASH:       chunk().emit_byte(OP_DIV, line); break;
-        case TOKEN_SLASH_SLASH: chunk().emit_byte(OP_FLOORDIV, line); break;
-        case TOKEN_PERCENT:     chunk().emit_byte(OP_MOD, line); break;
-        case TOKEN_LT:          chunk().emit_byte(OP_LT, line); break;
-        case TOKEN_LEQ:         chunk().emit_byte(OP_LEQ, line); break;
-        case TOKEN_GT:          chunk().emit_byte(OP_GT, line); break;
-        case TOKEN_GEQ:         chunk().emit_byte(OP_GEQ, line); break;
-        case TOKEN_EQEQ:        chunk().emit_byte(OP_EQEQ, line); break;
-        case TOKEN_NEQ:         chunk().emit_byte(OP_NEQ, line); break;
+        case TOKEN_PLUS:        op = OP_ADD; break;
+        case TOKEN_MINUS:       op = OP_SUB; break;
+        case TOKEN_STAR:        op = OP_MUL; break;
+        case TOKEN_SLASH:       op = OP_DIV; break;
+        case TOKEN_SLASH_SLASH: op = OP_FLOORDIV; break;
+        case TOKEN_PERCENT:     op = OP_MOD; break;
+        case TOKEN_LT:          op = OP_LT; break;
+        case TOKEN_LEQ:         op = OP_LEQ; break;
+        case TOKEN_GT:          op = OP_GT; break;
+        case TOKEN_GEQ:         op = OP_GEQ; break;
+        case TOKEN_EQEQ:        op = OP_EQEQ; break;
+        case TOKEN_NEQ:         op = OP_NEQ; break;
         }
         // clang-format on
+        chunk().emit_byte(num_variant(op, *node.lhs, *node.rhs), line);
     }
 
     void visit_subscr(SubscrNode &node) override
@@ -161,8 +298,10 @@ struct Compiler final : AstVisitor {
         if (op_tag != TOKEN_EQ)
             visit_expr(*node.lhs);
         visit_expr(*node.rhs);
-        if (op_tag != TOKEN_EQ)
-            chunk().emit_byte(desugar_assign(op_tag), line);
+        if (op_tag != TOKEN_EQ) {
+            chunk().emit_byte(num_variant(desugar_assign(op_tag), *node.lhs, *node.rhs), line);
+            depth--;
+        }
 
         if (node.lhs->tag == NODE_IDENT) {
             // ident set
@@ -191,9 +330,81 @@ struct Compiler final : AstVisitor {
         chunk().emit_byte(chunk().add_constant(MK_OBJ(str)), line);
     }
 
+    FnDeclNode *inline_target(CallNode &node)
+    {
+        if (options.inline_threshold <= 0 || node.lhs->tag != NODE_IDENT)
+            return nullptr;
+        DeclNode *decl = static_cast<IdentNode &>(*node.lhs).decl;
+        if (decl->tag != NODE_FN_DECL || decl->loc.tag != LOC_GLOBAL || decl->flags & (FLAG_ASSIGNED | FLAG_METHOD))
+            return nullptr;
+        auto *callee = static_cast<FnDeclNode *>(decl);
+        if (callee->arity != node.arity || callee == fn_node)
+            return nullptr;
+        i32 nesting = 0;
+        for (InlineFrame *frame = inlining; frame; frame = frame->parent) {
+            if (frame->callee == callee)
+                return nullptr;
+            nesting++;
+        }
+        if (nesting == MAX_INLINE_DEPTH)
+            return nullptr;
+        InlineCheck check(*callee, options.inline_threshold);
+        if (!check.ok || depth + check.slot_cnt > MAX_LOCALS)
+            return nullptr;
+        if (options.inline_report) {
+            fprintf(stderr, "[line %d] inlined %.*s into %.*s (size %d)\n", node.span.line, callee->span.len,
+                callee->span.start, fn_node->span.len, fn_node->span.start, check.size);
+        }
+        return callee;
+    }
+
+    // leaves the value on top of the stack in the result slot and drops the rest of the inlined frame
+    void emit_inline_return(const i32 line)
+    {
+        if (depth - 1 != inlining->base) {
+            chunk().emit_byte(OP_SET_LOCAL, line);
+            chunk().emit_byte(inlining->base, line);
+            emit_pops(depth - (inlining->base + 1), line);
+        }
+        inlining->returns.push(emit_jump(OP_JUMP, line));
+    }
+
+    // NOTE:
+    // instead of pushing the callee and calling it, the args are pushed as the first locals of an inlined body
+    //      OP_GET_LOCAL      <arg 0>
+    //      OP_GET_LOCAL      <arg 1>
+    //      body              (locals are offset by base, the slot of arg 0)
+    //      OP_SET_LOCAL base (for every return)
+    //      OP_POP_N          <args and locals>
+    //      OP_JUMP           (to the end)
+    //      ...
+    // the inlined body is recorded in the chunk so that runtime errors still list the callee in the stack trace
+    void visit_inline_call(CallNode &node, FnDeclNode &callee)
+    {
+        const i32 line = node.span.line;
+        InlineFrame frame = {&callee, depth, {}, inlining};
+        for (i32 i = 0; i < node.arity; i++)
+            visit_expr(*node.args[i]);
+        const i32 start = chunk().code().len();
+        inlining = &frame;
+        visit_block(*callee.body);
+        chunk().emit_byte(OP_NULL, line);
+        depth++;
+        emit_inline_return(line);
+        for (i32 i = 0; i < frame.returns.len(); i++)
+            patch_jump(node.span, frame.returns[i]);
+        const i32 name = chunk().add_constant(MK_OBJ(alloc<StringObj>(vm, callee.span)));
+        chunk().inlined().push({start, chunk().code().len(), name, line});
+        inlining = frame.parent;
+    }
+
     void visit_call(CallNode &node) override
     {
         const i32 line = node.span.line;
+        if (FnDeclNode *callee = inline_target(node)) {
+            visit_inline_call(node, *callee);
+            return;
+        }
         visit_expr(*node.lhs);
         for (i32 i = 0; i < node.arity; i++)
             visit_expr(*node.args[i]);
@@ -216,6 +427,7 @@ struct Compiler final : AstVisitor {
         //      ...              (destination of jump 2)
         const i32 offset1 = emit_jump(OP_JUMP_IF_FALSE, line);
         chunk().emit_byte(OP_POP, line);
+        depth--;
         visit_block(*node.thn);
         const i32 offset2 = emit_jump(OP_JUMP, line);
         patch_jump(node.span, offset1);
@@ -225,39 +437,56 @@ struct Compiler final : AstVisitor {
         patch_jump(node.span, offset2);
     }
 
+    void visit_expr(Node &node) override
+    {
+        const i32 saved_depth = depth;
+        AstVisitor::visit_expr(node);
+        depth = saved_depth + 1;
+    }
+
     void visit_expr_stmt(ExprStmtNode &node) override
     {
         visit_expr(*node.expr);
         chunk().emit_byte(OP_POP, node.span.line);
+        depth--;
     }
 
     void visit_return(ReturnNode &node) override
     {
         const i32 line = node.span.line;
+        const i32 saved_depth = depth;
         if (node.expr) {
             visit_expr(*node.expr);
-        } else if (fn_node->flags & FLAG_INIT) {
+        } else if (fn_node->flags & FLAG_INIT && !inlining) {
             chunk().emit_byte(OP_GET_LOCAL, line);
             chunk().emit_byte(fn_node->arity - 1, line);
         } else {
             chunk().emit_byte(OP_NULL, line);
         }
-        chunk().emit_byte(OP_RETURN, line);
+        depth = saved_depth + 1;
+        if (inlining)
+            emit_inline_return(line);
+        else
+            chunk().emit_byte(OP_RETURN, line);
+        depth = saved_depth;
     }
 
     void visit_print(PrintNode &node) override
     {
         visit_expr(*node.expr);
         chunk().emit_byte(OP_PRINT, node.span.line);
+        depth--;
     }
 
     void visit_var_decl(VarDeclNode &node) override
     {
         const i32 line = node.span.line;
-        if (node.init)
+        if (node.init) {
             visit_expr(*node.init);
-        else
+        } else {
             chunk().emit_byte(OP_NULL, line);
+            depth++;
+        }
         // move variable on heap if it is captured
         if (node.flags & FLAG_CAPTURED) {
             chunk().emit_byte(OP_HEAPVAL, line);
@@ -269,8 +498,10 @@ struct Compiler final : AstVisitor {
     {
         FnObj *parent = this->fn;
         FnDeclNode *parent_node = this->fn_node;
+        const i32 parent_depth = this->depth;
         this->fn = alloc<FnObj>(vm, alloc<StringObj>(vm, node.span), Chunk(), node.arity);
         this->fn_node = &node;
+        this->depth = node.arity;
 
         const i32 line = node.span.line;
         for (i32 i = 0; i < node.arity; i++) {
@@ -288,10 +519,14 @@ struct Compiler final : AstVisitor {
             chunk().emit_byte(OP_NULL, line);
         }
         chunk().emit_byte(OP_RETURN, line);
+        // the jumps of a chunk with errors may be truncated
+        if (options.peephole && errarr.len() == 0)
+            peephole(chunk());
         // disassemble_chunk(chunk(), fn->name->str.chars());
         FnObj *result = this->fn;
         this->fn = parent;
         this->fn_node = parent_node;
+        this->depth = parent_depth;
         return result;
     }
 
@@ -312,6 +547,7 @@ struct Compiler final : AstVisitor {
             chunk().emit_byte(OP_HEAPVAL, line);
             chunk().emit_byte(node.loc.idx, line);
         }
+        depth++;
     }
 
     void visit_block(BlockNode &node) override
@@ -330,37 +566,12 @@ struct Compiler final : AstVisitor {
             chunk().emit_byte(OP_POP_N, line);
             chunk().emit_byte(node.local_cnt, line);
         }
-    }
-
-    ClosureObj *visit(ModuleNode &node)
-    {
-        ClosureObj *main = nullptr;
-        for (i32 i = 0; i < node.cnt; i++)
-            vm.globals.push(MK_NULL);
-        for (i32 i = 0; i < node.cnt; i++) {
-            if (node.decls[i]->tag == NODE_FN_DECL) {
-                FnDeclNode &fn_node = static_cast<FnDeclNode &>(*node.decls[i]);
-                ClosureObj *closure = alloc<ClosureObj>(vm, compile_fn_body(fn_node), fn_node.capture_cnt);
-                vm.globals[fn_node.loc.idx] = MK_OBJ(closure);
-                if (fn_node.span == "main")
-                    main = closure;
-            } else {
-                auto &class_node = static_cast<ClassDeclNode &>(*node.decls[i]);
-                ClassObj *klass = alloc<ClassObj>(vm, alloc<StringObj>(vm, class_node.span));
-                for (i32 i = 0; i < class_node.cnt; i++) {
-                    FnDeclNode &fn_node = static_cast<FnDeclNode &>(*class_node.methods[i]);
-                    ClosureObj *closure = alloc<ClosureObj>(vm, compile_fn_body(fn_node), fn_node.capture_cnt);
-                    klass->methods.insert(*alloc<StringObj>(vm, fn_node.span), MK_OBJ(closure));
-                }
-                vm.globals[class_node.loc.idx] = MK_OBJ(klass);
-            }
-        }
-        return main;
+        depth -= node.local_cnt;
     }
 };
 
-ClosureObj *compile(VM &vm, ModuleNode &node, Dynarr<ErrMsg> &errarr)
+ClosureObj *compile(VM &vm, ModuleNode &node, Dynarr<ErrMsg> &errarr, const CompileOptions &options)
 {
-    Compiler compiler(vm, errarr);
-    return compiler.visit(node);
+    Compiler compiler(vm, errarr, options);
+    return compile_module(vm, node, compiler);
 }
\ No newline at end of file
@@ -1,6 +1,51 @@
 #pragma once
 #include "ast.h"
 #include "error.h"
+#include "gc.h"
 #include "object.h"
 
-ClosureObj *compile(VM &vm, ModuleNode &node, Dynarr<ErrMsg> &errarr);
+#define DEFAULT_INLINE_THRESHOLD (48)
+
+struct CompileOptions {
+    bool peephole = true; // run the peephole optimizer over every compiled fn
+    // calls to top-level fns with at most this many ast nodes are inlined, 0 disables inlining
+    i32 inline_threshold = DEFAULT_INLINE_THRESHOLD;
+    bool inline_report = false; // print every inlined call to stderr
+};
+
+ClosureObj *compile(VM &vm, ModuleNode &node, Dynarr<ErrMsg> &errarr, const CompileOptions &options);
+
+// list literal whose elements are all atoms built at compile time, nullptr if it has other elements or none.
+// the list is a template that is copied each time the literal is evaluated
+ListObj *const_list(VM &vm, const ListNode &node);
+
+// compiles the fn and class decls of the module into globals with compiler.compile_fn_body, returns main
+template <typename Compiler>
+ClosureObj *compile_module(VM &vm, ModuleNode &node, Compiler &compiler)
+{
+    ClosureObj *main = nullptr;
+    for (i32 i = 0; i < node.cnt; i++)
+        vm.globals.push(MK_NULL);
+    for (i32 i = 0; i < node.cnt; i++) {
+        if (node.decls[i]->tag == NODE_FN_DECL) {
+            FnDeclNode &fn_node = static_cast<FnDeclNode &>(*node.decls[i]);
+            ClosureObj *closure = alloc<ClosureObj>(vm, compiler.compile_fn_body(fn_node), fn_node.capture_cnt);
+            vm.globals[fn_node.loc.idx] = MK_OBJ(closure);
+            if (fn_node.span == "main")
+                main = closure;
+        } else {
+            auto &class_node = static_cast<ClassDeclNode &>(*node.decls[i]);
+            ClassObj *klass = alloc<ClassObj>(vm, alloc<StringObj>(vm, class_node.span));
+            for (i32 i = 0; i < class_node.cnt; i++) {
+                FnDeclNode &fn_node = static_cast<FnDeclNode &>(*class_node.methods[i]);
+                ClosureObj *closure = alloc<ClosureObj>(vm, compiler.compile_fn_body(fn_node), fn_node.capture_cnt);
+                klass->methods.insert(*alloc<StringObj>(vm, fn_node.span), MK_OBJ(closure));
+            }
+            vm.globals[class_node.loc.idx] = MK_OBJ(klass);
+        }
+    }
+    return main;
+}
+
+// compiles to the register instruction set run by run_reg_vm
+ClosureObj *compile_reg(VM &vm, ModuleNode &node, Dynarr<ErrMsg> &errarr);
@@ -227,7 +227,21 @@ const char *opcode_str(const OpCode op)
     case OP_NEQ:           return "OP_NEQ";
     case OP_NEGATE:        return "OP_NEGATE";
     case OP_NOT:           return "OP_NOT";
+    case OP_ADD_NUM:       return "OP_ADD_NUM";
+    case OP_SUB_NUM:       return "OP_SUB_NUM";
+    case OP_MUL_NUM:       return "OP_MUL_NUM";
+    case OP_DIV_NUM:       return "OP_DIV_NUM";
+    case OP_FLOORDIV_NUM:  return "OP_FLOORDIV_NUM";
+    case OP_MOD_NUM:       return "OP_MOD_NUM";
+    case OP_LT_NUM:        return "OP_LT_NUM";
+    case OP_LEQ_NUM:       return "OP_LEQ_NUM";
+    case OP_GT_NUM:        return "OP_GT_NUM";
+    case OP_GEQ_NUM:       return "OP_GEQ_NUM";
+    case OP_EQEQ_NUM:      return "OP_EQEQ_NUM";
+    case OP_NEQ_NUM:       return "OP_NEQ_NUM";
     case OP_LIST:          return "OP_LIST";
+    case OP_LIST_LONG:     return "OP_LIST_LONG";
+    case OP_LIST_CONST:    return "OP_LIST_CONST";
     case OP_CLOSURE:       return "OP_CLOSURE";
     case OP_CLASS:         return "OP_CLASS";
     case OP_METHOD:        return "OP_METHOD";
@@ -247,6 +261,10 @@ const char *opcode_str(const OpCode op)
     case OP_GET_FIELD:     return "OP_GET_FIELD";
     case OP_SET_FIELD:     return "OP_SET_FIELD";
     case OP_GET_METHOD:    return "OP_GET_METHOD";
+    case OP_GET_SUBSCR_LIST:  return "OP_GET_SUBSCR_LIST";
+    case OP_SET_SUBSCR_LIST:  return "OP_SET_SUBSCR_LIST";
+    case OP_GET_FIELD_CACHED: return "OP_GET_FIELD_CACHED";
+    case OP_SET_FIELD_CACHED: return "OP_SET_FIELD_CACHED";
     case OP_JUMP_IF_FALSE: return "OP_JUMP_IF_FALSE";
     case OP_JUMP_IF_TRUE:  return "OP_JUMP_IF_TRUE";
     case OP_JUMP:          return "OP_JUMP";
@@ -265,9 +283,9 @@ const char *opcode_str(const OpCode op)
 void disassemble_chunk(const Chunk &chunk, const char *name)
 {
     printf("     [disassembly for %s]\n", name);
-    for (i32 i = 0; i < chunk.code().len(); i++) {
+    for (i32 i = 0; i < chunk.instrs_len(); i++) {
         printf("%4d | ", i);
-        const u8 op = chunk.code()[i];
+        const u8 op = chunk.instrs()[i];
         printf("%-20s", opcode_str(OpCode(op)));
         switch (op) {
         case OP_GET_LOCAL:
@@ -281,28 +299,36 @@ void disassemble_chunk(const Chunk &chunk, const char *name)
         case OP_CALL:
         case OP_POP_N:
         case OP_LIST:
-        case OP_HEAPVAL: printf("%d\n", chunk.code()[++i]); break;
+        case OP_HEAPVAL: printf("%d\n", chunk.instrs()[++i]); break;
+        case OP_LIST_LONG: {
+            const u16 cnt = (i += 2, (chunk.instrs()[i - 1] << 8) | chunk.instrs()[i]);
+            printf("%d\n", cnt);
+            break;
+        }
         case OP_JUMP_IF_FALSE:
         case OP_JUMP_IF_TRUE:
         case OP_JUMP: {
-            const u16 offset = (i += 2, (chunk.code()[i - 1] << 8) | chunk.code()[i]);
+            const u16 offset = (i += 2, (chunk.instrs()[i - 1] << 8) | chunk.instrs()[i]);
             printf("%d\n", offset);
             break;
         }
         case OP_GET_FIELD:
         case OP_SET_FIELD:
+        case OP_GET_FIELD_CACHED:
+        case OP_SET_FIELD_CACHED:
         case OP_GET_METHOD:
+        case OP_LIST_CONST:
         case OP_GET_CONST: {
-            print_val(chunk.constants()[chunk.code()[++i]]);
+            print_val(chunk.constants()[chunk.instrs()[++i]]);
             printf("\n");
             break;
         }
         case OP_CLOSURE: {
-            const i32 capture_cnt = chunk.code()[++i];
+            const i32 capture_cnt = chunk.instrs()[++i];
             printf("%d\n", capture_cnt);
             for (i32 j = 0; j < capture_cnt; j++) {
-                printf("     | %*s%s\n", 20, "", loc_tag_str(LocTag(chunk.code()[++i])));
-                printf("     | %*s%d\n", 20, "", chunk.code()[++i]);
+                printf("     | %*s%s\n", 20, "", loc_tag_str(LocTag(chunk.instrs()[++i])));
+                printf("     | %*s%d\n", 20, "", chunk.instrs()[++i]);
             }
             break;
         }
@@ -29,3 +29,51 @@ ListObj *convert_from(Value val)
         return AS_LIST(val);
     throw "error: ListObj*";
 }
+
+template <>
+StringObj *convert_from(Value val)
+{
+    if (IS_STRING(val))
+        return AS_STRING(val);
+    throw "error: StringObj*";
+}
+
+template <>
+StringBuilderObj *convert_from(Value val)
+{
+    if (IS_STRING_BUILDER(val))
+        return AS_STRING_BUILDER(val);
+    throw "error: StringBuilderObj*";
+}
+
+template <>
+MapObj *convert_from(Value val)
+{
+    if (IS_MAP(val))
+        return AS_MAP(val);
+    throw "error: MapObj*";
+}
+
+template <>
+SetObj *convert_from(Value val)
+{
+    if (IS_SET(val))
+        return AS_SET(val);
+    throw "error: SetObj*";
+}
+
+template <>
+DequeObj *convert_from(Value val)
+{
+    if (IS_DEQUE(val))
+        return AS_DEQUE(val);
+    throw "error: DequeObj*";
+}
+
+template <>
+F64ArrayObj *convert_from(Value val)
+{
+    if (IS_F64ARRAY(val))
+        return AS_F64ARRAY(val);
+    throw "error: F64ArrayObj*";
+}
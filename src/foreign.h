@@ -4,11 +4,16 @@
 // TODO other objects (specifically ObjInstance * and some others)
 
 template <typename T>
-constexpr bool is_foreign_fn_arg = (is_same<T, Value>            // unchecked Value
-                                    || is_same<T, double>        // VAL_NUM
-                                    || is_same<T, bool>          // VAL_BOOL
-                                    || is_same<T, ListObj *>     // VAL_OBJ, OBJ_LIST
-                                    || is_same<T, StringObj *>); // VAL_OBJ, OBJ_STRING
+constexpr bool is_foreign_fn_arg = (is_same<T, Value>                   // unchecked Value
+                                    || is_same<T, double>               // VAL_NUM
+                                    || is_same<T, bool>                 // VAL_BOOL
+                                    || is_same<T, ListObj *>            // VAL_OBJ, OBJ_LIST
+                                    || is_same<T, StringObj *>          // VAL_OBJ, OBJ_STRING
+                                    || is_same<T, StringBuilderObj *>   // VAL_OBJ, OBJ_STRING_BUILDER
+                                    || is_same<T, MapObj *>             // VAL_OBJ, OBJ_MAP
+                                    || is_same<T, SetObj *>             // VAL_OBJ, OBJ_SET
+                                    || is_same<T, DequeObj *>           // VAL_OBJ, OBJ_DEQUE
+                                    || is_same<T, F64ArrayObj *>);      // VAL_OBJ, OBJ_F64ARRAY
 
 template <typename>
 constexpr bool is_foreign_fn = false;
@@ -17,6 +22,11 @@ template <typename R, typename... Args>
 constexpr bool is_foreign_fn<R (*)(Args...)> =
     (is_foreign_fn_arg<R> || is_same<R, void>) && (is_foreign_fn_arg<Args> && ...);
 
+// a foreign fn that needs to allocate takes the VM as its first parameter, it is not counted in the arity
+template <typename R, typename... Args>
+constexpr bool is_foreign_fn<R (*)(VM &, Args...)> =
+    (is_foreign_fn_arg<R> || is_same<R, void>) && (is_foreign_fn_arg<Args> && ...);
+
 template <typename>
 struct FunctionArity;
 
@@ -25,6 +35,11 @@ struct FunctionArity<R (*)(Args...)> {
     static constexpr int value = sizeof...(Args);
 };
 
+template <typename R, typename... Args>
+struct FunctionArity<R (*)(VM &, Args...)> {
+    static constexpr int value = sizeof...(Args);
+};
+
 template <int... I>
 struct IdxSeq {};
 
@@ -48,6 +63,16 @@ template <>
 ListObj *convert_from(Value val);
 template <>
 StringObj *convert_from(Value val);
+template <>
+StringBuilderObj *convert_from(Value val);
+template <>
+MapObj *convert_from(Value val);
+template <>
+SetObj *convert_from(Value val);
+template <>
+DequeObj *convert_from(Value val);
+template <>
+F64ArrayObj *convert_from(Value val);
 
 inline Value convert_to(Value val)
 {
@@ -70,7 +95,7 @@ inline Value convert_to(Obj *val)
 }
 
 template <auto F, typename R, typename... Args, int... I>
-Value foreign_fn_call(Value *vals, R (*)(Args...), IdxSeq<I...>)
+Value foreign_fn_call(VM &, Value *vals, R (*)(Args...), IdxSeq<I...>)
 {
     if constexpr (is_same<R, void>) {
         F(convert_from<Args>(vals[I])...);
@@ -80,13 +105,24 @@ Value foreign_fn_call(Value *vals, R (*)(Args...), IdxSeq<I...>)
     }
 }
 
+template <auto F, typename R, typename... Args, int... I>
+Value foreign_fn_call(VM &vm, Value *vals, R (*)(VM &, Args...), IdxSeq<I...>)
+{
+    if constexpr (is_same<R, void>) {
+        F(vm, convert_from<Args>(vals[I])...);
+        return MK_NULL;
+    } else {
+        return convert_to(F(vm, convert_from<Args>(vals[I])...));
+    }
+}
+
 template <auto F>
-InterpResult wrap_foreign_fn(Value *vals)
+InterpResult wrap_foreign_fn(VM &vm, Value *vals)
 {
     constexpr int N = FunctionArity<decltype(F)>::value;
     using Idxs = typename MakeIdxSeq<N>::type;
     try {
-        return InterpResult{.tag = INTERP_OK, .val = foreign_fn_call<F>(vals, F, Idxs{})};
+        return InterpResult{.tag = INTERP_OK, .val = foreign_fn_call<F>(vm, vals, F, Idxs{})};
     } catch (const char *message) {
         return InterpResult{.tag = INTERP_ERR, .message = message};
     }
@@ -101,3 +137,14 @@ void define_foreign_method(VM &vm, ClassObj &klass, const String &name)
     ForeignFnObj *f_fn = alloc<ForeignFnObj>(vm, string, wrap_foreign_fn<F>, N);
     klass.methods.insert(*string, MK_OBJ(f_fn));
 }
+
+// defines a global visible to every module, must be called before compiling
+template <auto F>
+    requires is_foreign_fn<decltype(F)>
+void define_foreign_fn(VM &vm, const String &name)
+{
+    constexpr int N = FunctionArity<decltype(F)>::value;
+    StringObj *string = alloc<StringObj>(vm, name);
+    ForeignFnObj *f_fn = alloc<ForeignFnObj>(vm, string, wrap_foreign_fn<F>, N);
+    vm.globals.push(MK_OBJ(f_fn));
+}
@@ -10,6 +10,19 @@ static void push_gray_stack(VM &vm, Obj *const obj)
     vm.gray.push(obj);
 }
 
+static void mark_map(VM &vm, ValMap &map)
+{
+    for (i32 i = 0; i < map.cap(); i++) {
+        auto &entry = map.slot(i);
+        if (entry.state != MAP_SLOT_FULL)
+            continue;
+        if (IS_OBJ(entry.key))
+            push_gray_stack(vm, AS_OBJ(entry.key));
+        if (IS_OBJ(entry.val))
+            push_gray_stack(vm, AS_OBJ(entry.val));
+    }
+}
+
 static void mark_table(VM &vm, ValTable &tab)
 {
     for (i32 i = 0; i < tab.cap(); i++) {
@@ -25,6 +38,12 @@ static void mark_table(VM &vm, ValTable &tab)
 void collect_garbage(VM &vm)
 {
     push_gray_stack(vm, vm.list_class);
+    push_gray_stack(vm, vm.string_class);
+    push_gray_stack(vm, vm.string_builder_class);
+    push_gray_stack(vm, vm.map_class);
+    push_gray_stack(vm, vm.set_class);
+    push_gray_stack(vm, vm.deque_class);
+    push_gray_stack(vm, vm.f64array_class);
 
     // mark roots
     const Value *const locals_lo = vm.val_stack;
@@ -59,6 +78,7 @@ void collect_garbage(VM &vm)
 
         switch (obj->tag) {
         case OBJ_FOREIGN_FN: {
+            push_gray_stack(vm, static_cast<ForeignFnObj *>(obj)->name);
             break;
         }
         case OBJ_FN: {
@@ -72,6 +92,11 @@ void collect_garbage(VM &vm)
                 if (IS_OBJ(val))
                     push_gray_stack(vm, AS_OBJ(val));
             }
+            const Dynarr<FieldCache> &caches = fn->chunk.field_caches();
+            for (i32 i = 0; i < caches.len(); i++) {
+                if (caches[i].key)
+                    push_gray_stack(vm, caches[i].key);
+            }
             break;
         }
         case OBJ_HEAP_VAL: {
@@ -93,6 +118,9 @@ void collect_garbage(VM &vm)
         }
         case OBJ_LIST: {
             ListObj *const list = static_cast<ListObj *>(obj);
+            // unboxed elements hold no references
+            if (list->kind != LIST_VAL)
+                break;
             // lo != nullptr because list.cap >= 8
             const Value *const val_lo = list->vals.raw();
             const Value *const val_hi = val_lo + list->vals.len();
@@ -104,6 +132,13 @@ void collect_garbage(VM &vm)
             break;
         }
         case OBJ_STRING: {
+            StringObj *const str = static_cast<StringObj *>(obj);
+            if (str->kind == STRING_ROPE) {
+                push_gray_stack(vm, str->lhs);
+                push_gray_stack(vm, str->rhs);
+            } else if (str->kind == STRING_SLICE) {
+                push_gray_stack(vm, str->parent);
+            }
             break;
         }
         case OBJ_CLASS: {
@@ -130,6 +165,28 @@ void collect_garbage(VM &vm)
             push_gray_stack(vm, f_method->fn);
             break;
         }
+        case OBJ_STRING_BUILDER: {
+            break;
+        }
+        case OBJ_MAP: {
+            mark_map(vm, static_cast<MapObj *>(obj)->map);
+            break;
+        }
+        case OBJ_SET: {
+            mark_map(vm, static_cast<SetObj *>(obj)->map);
+            break;
+        }
+        case OBJ_DEQUE: {
+            const Ringbuf<Value> &vals = static_cast<DequeObj *>(obj)->vals;
+            for (i32 i = 0; i < vals.len(); i++) {
+                if (IS_OBJ(vals[i]))
+                    push_gray_stack(vm, AS_OBJ(vals[i]));
+            }
+            break;
+        }
+        case OBJ_F64ARRAY: {
+            break;
+        }
         }
     }
 
@@ -0,0 +1,841 @@
+#include "jit.h"
+#include "ast.h"
+#include "gc.h"
+#include "value.h"
+#include <math.h>
+#include <stddef.h> // for offsetof
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h> // for getpid()
+
+#define CODE_BLOCK_SIZE (256 * 1024)
+
+CodeHeap::~CodeHeap()
+{
+    for (i32 i = 0; i < blocks_.len(); i++)
+        munmap(blocks_[i].base, blocks_[i].cap);
+    if (perf_map_)
+        fclose(perf_map_);
+}
+
+const u8 *CodeHeap::add(const u8 *code, const u64 len)
+{
+    if (blocks_.len() == 0 || blocks_[blocks_.len() - 1].cap - blocks_[blocks_.len() - 1].used < len) {
+        const u64 cap = len > CODE_BLOCK_SIZE ? (len + 4095) & ~u64(4095) : CODE_BLOCK_SIZE;
+        void *base = mmap(nullptr, cap, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED)
+            return nullptr;
+        blocks_.push({static_cast<u8 *>(base), cap, 0});
+    }
+    Block &block = blocks_[blocks_.len() - 1];
+    if (mprotect(block.base, block.cap, PROT_READ | PROT_WRITE) != 0)
+        return nullptr;
+    u8 *dst = block.base + block.used;
+    memcpy(dst, code, len);
+    if (mprotect(block.base, block.cap, PROT_READ | PROT_EXEC) != 0)
+        return nullptr;
+    block.used += (len + 15) & ~u64(15);
+    return dst;
+}
+
+void CodeHeap::add_perf_map(const u8 *code, const u64 len, const FnObj &fn)
+{
+    if (!perf_map_) {
+        char path[64];
+        snprintf(path, sizeof(path), "/tmp/perf-%d.map", getpid());
+        perf_map_ = fopen(path, "w");
+        if (!perf_map_)
+            return;
+    }
+    const i32 line = fn.chunk.lines().len() > 0 ? fn.chunk.lines()[0] : 0;
+    fprintf(perf_map_, "%llx %llx flood:%s:%d\n", static_cast<unsigned long long>(reinterpret_cast<u64>(code)),
+        static_cast<unsigned long long>(len), fn.name->str.chars(), line);
+    // perf may read it while the vm runs, or after it crashed
+    fflush(perf_map_);
+}
+
+// runs the gc like run_vm does after an instruction, sp is the stack pointer after it
+static void safepoint(VM &vm, Value *sp)
+{
+    vm.sp = sp;
+    collect_garbage(vm);
+    collect_garbage(vm);
+}
+
+// see the helpers in jit.h. the native code moves sp by the stack effect of the instruction
+typedef bool (*Helper)(VM &vm, CallFrame *frame, Value *sp, const u8 *instr);
+
+static void jit_error(VM &vm, const u8 *ip, const char *message)
+{
+    runtime_err(ip, vm, "%s", message);
+}
+
+// the generic forms of the arithmetic and comparison instructions, and the forms on numbers that are not inlined
+bool jit_binary(VM &vm, CallFrame *, Value *sp, const u8 *instr)
+{
+    // the forms on numbers are in the same order as the generic ones, see chunk.h
+    const OpCode op = *instr >= OP_ADD_NUM ? OpCode(*instr - OP_ADD_NUM + OP_ADD) : OpCode(*instr);
+    const Value lhs = sp[-2];
+    const Value rhs = sp[-1];
+    if (op == OP_EQEQ || op == OP_NEQ) {
+        sp[-2] = MK_BOOL(val_eq(lhs, rhs) == (op == OP_EQEQ));
+        return true;
+    }
+    if (op == OP_ADD && IS_STRING(lhs) && IS_STRING(rhs)) {
+        sp[-2] = MK_OBJ(concat_strings(vm, AS_STRING(lhs), AS_STRING(rhs)));
+        safepoint(vm, sp - 1);
+        return true;
+    }
+    if (!IS_NUM(lhs) || !IS_NUM(rhs)) {
+        const char *message = op == OP_ADD ? "operands must be numbers or strings" : "operands must be numbers";
+        runtime_err(instr + 1, vm, "%s", message);
+        return false;
+    }
+    const double x = AS_NUM(lhs);
+    const double y = AS_NUM(rhs);
+    // clang-format off
+    switch (op) {
+    case OP_ADD:      sp[-2] = MK_NUM(x + y); break;
+    case OP_SUB:      sp[-2] = MK_NUM(x - y); break;
+    case OP_MUL:      sp[-2] = MK_NUM(x * y); break;
+    case OP_DIV:      sp[-2] = MK_NUM(x / y); break;
+    case OP_FLOORDIV: sp[-2] = MK_NUM(floor(x / y)); break;
+    case OP_MOD:      sp[-2] = MK_NUM(fmod(x, y)); break;
+    case OP_LT:       sp[-2] = MK_BOOL(x < y); break;
+    case OP_LEQ:      sp[-2] = MK_BOOL(x <= y); break;
+    case OP_GT:       sp[-2] = MK_BOOL(x > y); break;
+    case OP_GEQ:      sp[-2] = MK_BOOL(x >= y); break;
+    default:          break;
+    }
+    // clang-format on
+    return true;
+}
+
+bool jit_list(VM &vm, CallFrame *, Value *sp, const u8 *instr)
+{
+    const i32 cnt = *instr == OP_LIST ? instr[1] : (instr[1] << 8) | instr[2];
+    sp -= cnt;
+    sp[0] = MK_OBJ(alloc<ListObj>(vm, sp, cnt));
+    safepoint(vm, sp + 1);
+    return true;
+}
+
+bool jit_list_const(VM &vm, CallFrame *frame, Value *sp, const u8 *instr)
+{
+    sp[0] = MK_OBJ(alloc<ListObj>(vm, AS_LIST(frame->closure->fn->chunk.constants()[instr[1]])));
+    safepoint(vm, sp + 1);
+    return true;
+}
+
+bool jit_heapval(VM &vm, CallFrame *frame, Value *sp, const u8 *instr)
+{
+    Value *bp = frame->bp;
+    bp[instr[1]] = MK_OBJ(alloc<HeapValObj>(vm, bp[instr[1]]));
+    safepoint(vm, sp);
+    return true;
+}
+
+bool jit_closure(VM &vm, CallFrame *frame, Value *sp, const u8 *instr)
+{
+    const u8 *ip = instr + 1;
+    const u8 captures = *ip++;
+    ClosureObj *closure = alloc<ClosureObj>(vm, AS_FN(sp[-1]), captures);
+    sp[-1] = MK_OBJ(closure);
+    Value *bp = frame->bp;
+    for (i32 i = 0; i < captures; i++) {
+        const LocTag tag = LocTag(*ip++);
+        const i32 idx = *ip++;
+        if (tag == LOC_CAPTURED_HEAPVAL)
+            closure->captures[i] = frame->closure->captures[idx];
+        else if (bp + idx != sp - 1)
+            closure->captures[i] = AS_HEAP_VAL(bp[idx]);
+        else
+            closure->captures[i] = alloc<HeapValObj>(vm, bp[idx]); // see run_vm
+    }
+    safepoint(vm, sp);
+    return true;
+}
+
+bool jit_get_heapval(VM &, CallFrame *frame, Value *sp, const u8 *instr)
+{
+    sp[0] = AS_HEAP_VAL(frame->bp[instr[1]])->val;
+    return true;
+}
+
+bool jit_set_heapval(VM &, CallFrame *frame, Value *sp, const u8 *instr)
+{
+    AS_HEAP_VAL(frame->bp[instr[1]])->val = sp[-1];
+    return true;
+}
+
+bool jit_get_captured(VM &, CallFrame *frame, Value *sp, const u8 *instr)
+{
+    sp[0] = frame->closure->captures[instr[1]]->val;
+    return true;
+}
+
+bool jit_set_captured(VM &, CallFrame *frame, Value *sp, const u8 *instr)
+{
+    frame->closure->captures[instr[1]]->val = sp[-1];
+    return true;
+}
+
+bool jit_get_global(VM &vm, CallFrame *, Value *sp, const u8 *instr)
+{
+    sp[0] = vm.globals[instr[1]];
+    return true;
+}
+
+bool jit_set_global(VM &vm, CallFrame *, Value *sp, const u8 *instr)
+{
+    vm.globals[instr[1]] = sp[-1];
+    return true;
+}
+
+// the quickened forms run as their generic forms
+bool jit_get_subscr(VM &vm, CallFrame *, Value *sp, const u8 *instr)
+{
+    if (!get_subscr(vm, instr + 1, sp[-2], sp[-1], sp[-2]))
+        return false;
+    safepoint(vm, sp - 1);
+    return true;
+}
+
+bool jit_set_subscr(VM &vm, CallFrame *, Value *sp, const u8 *instr)
+{
+    return set_subscr(vm, instr + 1, sp[-2], sp[-1], sp[-3]);
+}
+
+bool jit_get_field(VM &vm, CallFrame *frame, Value *sp, const u8 *instr)
+{
+    StringObj *prop = AS_STRING(frame->closure->fn->chunk.constants()[instr[1]]);
+    return get_field(vm, instr + 2, sp[-1], prop, sp[-1]);
+}
+
+bool jit_set_field(VM &vm, CallFrame *frame, Value *sp, const u8 *instr)
+{
+    StringObj *prop = AS_STRING(frame->closure->fn->chunk.constants()[instr[1]]);
+    return set_field(vm, instr + 2, sp[-1], prop, sp[-2]);
+}
+
+bool jit_get_method(VM &vm, CallFrame *frame, Value *sp, const u8 *instr)
+{
+    StringObj *prop = AS_STRING(frame->closure->fn->chunk.constants()[instr[1]]);
+    if (!get_method(vm, instr + 2, sp[-1], prop, sp[-1]))
+        return false;
+    safepoint(vm, sp);
+    return true;
+}
+
+bool jit_print(VM &, CallFrame *, Value *sp, const u8 *)
+{
+    print_val(sp[-1]);
+    printf("\n");
+    return true;
+}
+
+// see OP_CALL in run_vm. the result replaces the callee, so the native code moves sp by the argument cnt
+JitStatus jit_call(VM &vm, CallFrame *frame, Value *sp, const u8 *instr)
+{
+    const u8 *ip = instr + 2;
+    i32 param_cnt = instr[1];
+    const Value val = sp[-param_cnt - 1];
+    ClosureObj *closure;
+    Value self = MK_NULL;
+    if (IS_CLOSURE(val)) {
+        closure = AS_CLOSURE(val);
+    } else if (IS_CLASS(val)) {
+        ClassObj *klass = AS_CLASS(val);
+        closure = AS_CLOSURE(*klass->methods.find(*alloc<StringObj>(vm, "init")));
+        self = MK_OBJ(alloc<InstanceObj>(vm, klass));
+    } else if (IS_METHOD(val)) {
+        MethodObj *method = AS_METHOD(val);
+        closure = method->closure;
+        self = MK_OBJ(method->self);
+    } else if (IS_FOREIGN_METHOD(val) || IS_FOREIGN_FN(val)) {
+        ForeignFnObj *f_fn;
+        if (IS_FOREIGN_METHOD(val)) {
+            f_fn = AS_FOREIGN_METHOD(val)->fn;
+            sp[0] = MK_OBJ(AS_FOREIGN_METHOD(val)->self);
+            sp++;
+            param_cnt++;
+        } else {
+            f_fn = AS_FOREIGN_FN(val);
+        }
+        if (param_cnt != f_fn->arity) {
+            runtime_err(ip, vm, "incorrect number of arguments provided");
+            return JIT_ERR;
+        }
+        frame->ip = ip;
+        const InterpResult res = f_fn->wrap(vm, sp - param_cnt);
+        if (res.tag == INTERP_ERR) {
+            runtime_err(ip, vm, "%s", res.message);
+            return JIT_ERR;
+        }
+        sp -= param_cnt;
+        sp[-1] = res.val;
+        safepoint(vm, sp);
+        return JIT_RETURN;
+    } else {
+        runtime_err(ip, vm, "attempt to call non-callable");
+        return JIT_ERR;
+    }
+    if (closure->fn->arity != param_cnt + !IS_NULL(self)) {
+        runtime_err(ip, vm, "incorrect number of arguments provided");
+        return JIT_ERR;
+    }
+    if (vm.call_cnt + 1 >= MAX_CALL_FRAMES) {
+        runtime_err(ip, vm, "stack overflow");
+        return JIT_ERR;
+    }
+    if (!tier_up(vm, *closure->fn)) {
+        // run_vm calls it instead, and counts the call
+        frame->ip = instr;
+        vm.sp = sp;
+        return JIT_DEOPT;
+    }
+    if (!IS_NULL(self)) {
+        sp[0] = self;
+        sp++;
+        param_cnt++;
+    }
+    frame->ip = ip;
+    CallFrame *callee = frame + 1;
+    callee->closure = closure;
+    vm.call_cnt++;
+    closure->fn->call_cnt++;
+    const JitStatus status = closure->fn->jit(vm, callee, sp - param_cnt, sp);
+    if (status == JIT_RETURN)
+        vm.call_cnt--;
+    return status;
+}
+
+bool tier_up(VM &vm, FnObj &fn)
+{
+    if (!fn.jit && (fn.jit_unsupported || vm.tier_policy(vm, fn) != TIER_NATIVE))
+        return false;
+    return jit_compile(vm, fn);
+}
+
+#if defined(__x86_64__)
+
+static_assert(sizeof(Value) == 16 && offsetof(Value, as) == 8);
+
+// clang-format off
+enum Reg : u8 { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+enum Cond : u8 { CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_A = 0x7, CC_P = 0xa, CC_NP = 0xb };
+// clang-format on
+
+// registers that hold sp, bp, the vm and the frame
+#define SP_REG    (RBX)
+#define BP_REG    (R12)
+#define VM_REG    (R13)
+#define FRAME_REG (R15)
+
+// offset of the tag and the payload of sp[idx]
+#define TAG(idx)     (i32(idx) * i32(sizeof(Value)))
+#define PAYLOAD(idx) (i32(idx) * i32(sizeof(Value)) + 8)
+
+// the few instructions the templates need. memory operands are always [base + disp32]
+struct Asm {
+    Dynarr<u8> code;
+
+    i32 pos() const
+    {
+        return code.len();
+    }
+
+    void byte(const u8 b)
+    {
+        code.push(b);
+    }
+
+    void dword(const u32 d)
+    {
+        for (i32 i = 0; i < 4; i++)
+            byte(d >> (8 * i));
+    }
+
+    void qword(const u64 q)
+    {
+        for (i32 i = 0; i < 8; i++)
+            byte(q >> (8 * i));
+    }
+
+    // rex prefix if one is needed. w selects 64-bit operands, reg and rm are extended by their 4th bit
+    void rex(const bool w, const u8 reg, const u8 rm)
+    {
+        const u8 bits = (w << 3) | ((reg >> 3) << 2) | (rm >> 3);
+        if (bits)
+            byte(0x40 | bits);
+    }
+
+    void mem(const u8 reg, const Reg base, const i32 disp)
+    {
+        byte(0x80 | ((reg & 7) << 3) | (base & 7));
+        if ((base & 7) == RSP)
+            byte(0x24);
+        dword(disp);
+    }
+
+    void mov(const Reg dst, const Reg src)
+    {
+        rex(true, src, dst);
+        byte(0x89);
+        byte(0xc0 | ((src & 7) << 3) | (dst & 7));
+    }
+
+    void mov_imm(const Reg dst, const u64 imm)
+    {
+        rex(true, 0, dst);
+        byte(0xb8 | (dst & 7));
+        qword(imm);
+    }
+
+    void mov_imm32(const Reg dst, const u32 imm)
+    {
+        rex(false, 0, dst);
+        byte(0xb8 | (dst & 7));
+        dword(imm);
+    }
+
+    void store(const Reg base, const i32 disp, const Reg src)
+    {
+        rex(true, src, base);
+        byte(0x89);
+        mem(src, base, disp);
+    }
+
+    // mov dword [base + disp], imm
+    void store_imm32(const Reg base, const i32 disp, const u32 imm)
+    {
+        rex(false, 0, base);
+        byte(0xc7);
+        mem(0, base, disp);
+        dword(imm);
+    }
+
+    void lea(const Reg dst, const Reg base, const i32 disp)
+    {
+        rex(true, dst, base);
+        byte(0x8d);
+        mem(dst, base, disp);
+    }
+
+    // xmm registers below 8 only
+    void sse_mem(const u8 prefix, const u8 op, const u8 xmm, const Reg base, const i32 disp)
+    {
+        if (prefix)
+            byte(prefix);
+        rex(false, xmm, base);
+        byte(0x0f);
+        byte(op);
+        mem(xmm, base, disp);
+    }
+
+    void sse(const u8 prefix, const u8 op, const u8 dst, const u8 src)
+    {
+        byte(prefix);
+        byte(0x0f);
+        byte(op);
+        byte(0xc0 | (dst << 3) | src);
+    }
+
+    // cmp dword [base + disp], imm
+    void cmp_dword(const Reg base, const i32 disp, const u8 imm)
+    {
+        rex(false, 0, base);
+        byte(0x83);
+        mem(7, base, disp);
+        byte(imm);
+    }
+
+    // cmp byte [base + disp], imm
+    void cmp_byte(const Reg base, const i32 disp, const u8 imm)
+    {
+        rex(false, 0, base);
+        byte(0x80);
+        mem(7, base, disp);
+        byte(imm);
+    }
+
+    // xor byte [base + disp], imm
+    void xor_byte(const Reg base, const i32 disp, const u8 imm)
+    {
+        rex(false, 0, base);
+        byte(0x80);
+        mem(6, base, disp);
+        byte(imm);
+    }
+
+    // setcc of al (0) or cl (1)
+    void setcc(const Cond cc, const u8 reg)
+    {
+        byte(0x0f);
+        byte(0x90 | cc);
+        byte(0xc0 | reg);
+    }
+
+    // returns the position of the displacement, see patch
+    i32 jcc(const Cond cc)
+    {
+        byte(0x0f);
+        byte(0x80 | cc);
+        dword(0);
+        return pos() - 4;
+    }
+
+    i32 jmp()
+    {
+        byte(0xe9);
+        dword(0);
+        return pos() - 4;
+    }
+
+    void patch(const i32 at, const i32 target)
+    {
+        const u32 rel = target - (at + 4);
+        for (i32 i = 0; i < 4; i++)
+            code[at + i] = rel >> (8 * i);
+    }
+
+    void call(const void *fn)
+    {
+        mov_imm(RAX, reinterpret_cast<u64>(fn));
+        byte(0xff);
+        byte(0xd0);
+    }
+
+    void push(const Reg reg)
+    {
+        rex(false, 0, reg);
+        byte(0x50 | (reg & 7));
+    }
+
+    void pop(const Reg reg)
+    {
+        rex(false, 0, reg);
+        byte(0x58 | (reg & 7));
+    }
+};
+
+struct JumpFixup {
+    i32 at;     // position of the displacement
+    i32 target; // offset of the instruction jumped to
+};
+
+struct Jit {
+    Asm a;
+    Dynarr<JumpFixup> jumps;
+    Dynarr<i32> err_jumps;      // to the exit that returns JIT_ERR
+    Dynarr<i32> epilogue_jumps; // to the exit that returns eax
+
+    void push_val(const Value val)
+    {
+        u64 words[2];
+        memcpy(words, &val, sizeof(words));
+        a.mov_imm(RAX, words[0]);
+        a.store(SP_REG, TAG(0), RAX);
+        a.mov_imm(RAX, words[1]);
+        a.store(SP_REG, PAYLOAD(0), RAX);
+        a.lea(SP_REG, SP_REG, TAG(1));
+    }
+
+    // bools are written with their whole payload, so the native code can compare it as a byte
+    void set_bool_from_al(const i32 idx)
+    {
+        a.byte(0x0f); // movzx eax, al
+        a.byte(0xb6);
+        a.byte(0xc0);
+        a.store_imm32(SP_REG, TAG(idx), VAL_BOOL);
+        a.store(SP_REG, PAYLOAD(idx), RAX);
+    }
+
+    void helper(const Helper fn, const u8 *instr, const i32 effect)
+    {
+        a.mov(RDI, VM_REG);
+        a.mov(RSI, FRAME_REG);
+        a.mov(RDX, SP_REG);
+        a.mov_imm(RCX, reinterpret_cast<u64>(instr));
+        a.call(reinterpret_cast<const void *>(fn));
+        a.byte(0x84); // test al, al
+        a.byte(0xc0);
+        err_jumps.push(a.jcc(CC_E));
+        if (effect != 0)
+            a.lea(SP_REG, SP_REG, TAG(effect));
+    }
+
+    // reports message unless sp[idx] has tag
+    void check_tag(const i32 idx, const ValTag tag, const u8 *ip, const char *message)
+    {
+        a.cmp_dword(SP_REG, TAG(idx), tag);
+        const i32 ok = a.jcc(CC_E);
+        a.mov(RDI, VM_REG);
+        a.mov_imm(RSI, reinterpret_cast<u64>(ip));
+        a.mov_imm(RDX, reinterpret_cast<u64>(message));
+        a.call(reinterpret_cast<const void *>(jit_error));
+        err_jumps.push(a.jmp());
+        a.patch(ok, a.pos());
+    }
+
+    // xmm0 = lhs, xmm1 = rhs
+    void load_operands()
+    {
+        a.sse_mem(0xf2, 0x10, 0, SP_REG, PAYLOAD(-2));
+        a.sse_mem(0xf2, 0x10, 1, SP_REG, PAYLOAD(-1));
+    }
+
+    // sets al to the comparison of xmm0 and xmm1 made by op, false if either is NaN
+    void compare(const OpCode op)
+    {
+        // clang-format off
+        switch (op) {
+        case OP_LT:   a.sse(0x66, 0x2e, 1, 0); a.setcc(CC_A, 0); break;
+        case OP_LEQ:  a.sse(0x66, 0x2e, 1, 0); a.setcc(CC_AE, 0); break;
+        case OP_GT:   a.sse(0x66, 0x2e, 0, 1); a.setcc(CC_A, 0); break;
+        case OP_GEQ:  a.sse(0x66, 0x2e, 0, 1); a.setcc(CC_AE, 0); break;
+        case OP_EQEQ: a.sse(0x66, 0x2e, 0, 1); a.setcc(CC_E, 0); a.setcc(CC_NP, 1); a.byte(0x20); a.byte(0xc8); break;
+        case OP_NEQ:  a.sse(0x66, 0x2e, 0, 1); a.setcc(CC_NE, 0); a.setcc(CC_P, 1); a.byte(0x08); a.byte(0xc8); break;
+        default:      break;
+        }
+        // clang-format on
+    }
+
+    // inlined arithmetic on numbers. the generic form checks the tags first and otherwise calls jit_binary
+    void binary(const u8 *instr, const bool checked)
+    {
+        const OpCode op = checked ? OpCode(*instr) : OpCode(*instr - OP_ADD_NUM + OP_ADD);
+        i32 slow_lhs = 0;
+        i32 slow_rhs = 0;
+        if (checked) {
+            a.cmp_dword(SP_REG, TAG(-2), VAL_NUM);
+            slow_lhs = a.jcc(CC_NE);
+            a.cmp_dword(SP_REG, TAG(-1), VAL_NUM);
+            slow_rhs = a.jcc(CC_NE);
+        }
+        load_operands();
+        // clang-format off
+        switch (op) {
+        case OP_ADD: a.sse(0xf2, 0x58, 0, 1); break;
+        case OP_SUB: a.sse(0xf2, 0x5c, 0, 1); break;
+        case OP_MUL: a.sse(0xf2, 0x59, 0, 1); break;
+        case OP_DIV: a.sse(0xf2, 0x5e, 0, 1); break;
+        default:     compare(op); break;
+        }
+        // clang-format on
+        if (op <= OP_DIV)
+            a.sse_mem(0xf2, 0x11, 0, SP_REG, PAYLOAD(-2));
+        else
+            set_bool_from_al(-2);
+        if (checked) {
+            const i32 done = a.jmp();
+            a.patch(slow_lhs, a.pos());
+            a.patch(slow_rhs, a.pos());
+            helper(jit_binary, instr, 0);
+            a.patch(done, a.pos());
+        }
+        a.lea(SP_REG, SP_REG, TAG(-1));
+    }
+
+    // returns false if the chunk has an instruction run_vm does not run either
+    bool compile(const FnObj &fn, Dynarr<i32> &native_offsets)
+    {
+        const Chunk &chunk = fn.chunk;
+        const u8 *code = chunk.instrs();
+        const i32 len = chunk.instrs_len();
+        a.push(RBX);
+        a.push(RBP);
+        a.push(R12);
+        a.push(R13);
+        a.push(R14);
+        a.push(R15);
+        a.byte(0x48); // sub rsp, 8, to align the stack for calls
+        a.byte(0x83);
+        a.byte(0xec);
+        a.byte(0x08);
+        a.mov(VM_REG, RDI);
+        a.mov(FRAME_REG, RSI);
+        a.mov(BP_REG, RDX);
+        a.mov(SP_REG, RCX);
+        a.store(FRAME_REG, offsetof(CallFrame, bp), BP_REG);
+
+        for (i32 offset = 0; offset < len; offset += instr_len(code + offset)) {
+            const u8 *instr = code + offset;
+            // the ip run_vm would report an error of the instruction with
+            const u8 *ip = instr + instr_len(instr);
+            native_offsets[offset] = a.pos();
+            switch (*instr) {
+            case OP_NULL: push_val(MK_NULL); break;
+            case OP_TRUE: push_val(MK_BOOL(true)); break;
+            case OP_FALSE: push_val(MK_BOOL(false)); break;
+            case OP_ADD:
+            case OP_SUB:
+            case OP_MUL:
+            case OP_DIV:
+            case OP_LT:
+            case OP_LEQ:
+            case OP_GT:
+            case OP_GEQ: binary(instr, true); break;
+            case OP_ADD_NUM:
+            case OP_SUB_NUM:
+            case OP_MUL_NUM:
+            case OP_DIV_NUM:
+            case OP_LT_NUM:
+            case OP_LEQ_NUM:
+            case OP_GT_NUM:
+            case OP_GEQ_NUM:
+            case OP_EQEQ_NUM:
+            case OP_NEQ_NUM: binary(instr, false); break;
+            case OP_FLOORDIV:
+            case OP_MOD:
+            case OP_EQEQ:
+            case OP_NEQ:
+            case OP_FLOORDIV_NUM:
+            case OP_MOD_NUM: helper(jit_binary, instr, -1); break;
+            case OP_NEGATE: {
+                check_tag(-1, VAL_NUM, ip, "operand must be number");
+                a.xor_byte(SP_REG, PAYLOAD(-1) + 7, 0x80);
+                break;
+            }
+            case OP_NOT: {
+                check_tag(-1, VAL_BOOL, ip, "operand must be boolean");
+                a.xor_byte(SP_REG, PAYLOAD(-1), 1);
+                break;
+            }
+            case OP_LIST: helper(jit_list, instr, 1 - instr[1]); break;
+            case OP_LIST_LONG: helper(jit_list, instr, 1 - ((instr[1] << 8) | instr[2])); break;
+            case OP_LIST_CONST: helper(jit_list_const, instr, 1); break;
+            case OP_HEAPVAL: helper(jit_heapval, instr, 0); break;
+            case OP_CLOSURE: helper(jit_closure, instr, 0); break;
+            case OP_GET_CONST: push_val(chunk.constants()[instr[1]]); break;
+            case OP_GET_LOCAL: {
+                a.sse_mem(0, 0x10, 0, BP_REG, TAG(instr[1]));
+                a.sse_mem(0, 0x11, 0, SP_REG, TAG(0));
+                a.lea(SP_REG, SP_REG, TAG(1));
+                break;
+            }
+            case OP_SET_LOCAL: {
+                a.sse_mem(0, 0x10, 0, SP_REG, TAG(-1));
+                a.sse_mem(0, 0x11, 0, BP_REG, TAG(instr[1]));
+                break;
+            }
+            case OP_GET_HEAPVAL: helper(jit_get_heapval, instr, 1); break;
+            case OP_SET_HEAPVAL: helper(jit_set_heapval, instr, 0); break;
+            case OP_GET_CAPTURED: helper(jit_get_captured, instr, 1); break;
+            case OP_SET_CAPTURED: helper(jit_set_captured, instr, 0); break;
+            case OP_GET_GLOBAL: helper(jit_get_global, instr, 1); break;
+            case OP_SET_GLOBAL: helper(jit_set_global, instr, 0); break;
+            case OP_GET_SUBSCR:
+            case OP_GET_SUBSCR_LIST: helper(jit_get_subscr, instr, -1); break;
+            case OP_SET_SUBSCR:
+            case OP_SET_SUBSCR_LIST: helper(jit_set_subscr, instr, -2); break;
+            case OP_GET_FIELD:
+            case OP_GET_FIELD_CACHED: helper(jit_get_field, instr, 0); break;
+            case OP_SET_FIELD:
+            case OP_SET_FIELD_CACHED: helper(jit_set_field, instr, -1); break;
+            case OP_GET_METHOD: helper(jit_get_method, instr, 0); break;
+            case OP_JUMP: {
+                jumps.push({a.jmp(), offset + 3 + ((instr[1] << 8) | instr[2])});
+                break;
+            }
+            case OP_JUMP_IF_FALSE:
+            case OP_JUMP_IF_TRUE: {
+                check_tag(-1, VAL_BOOL, ip, "operand must be boolean");
+                a.cmp_byte(SP_REG, PAYLOAD(-1), 0);
+                const i32 target = offset + 3 + ((instr[1] << 8) | instr[2]);
+                jumps.push({a.jcc(*instr == OP_JUMP_IF_FALSE ? CC_E : CC_NE), target});
+                break;
+            }
+            case OP_CALL: {
+                a.mov(RDI, VM_REG);
+                a.mov(RSI, FRAME_REG);
+                a.mov(RDX, SP_REG);
+                a.mov_imm(RCX, reinterpret_cast<u64>(instr));
+                a.call(reinterpret_cast<const void *>(jit_call));
+                a.byte(0x85); // test eax, eax
+                a.byte(0xc0);
+                epilogue_jumps.push(a.jcc(CC_NE));
+                a.lea(SP_REG, SP_REG, TAG(-instr[1]));
+                break;
+            }
+            case OP_RETURN: {
+                a.sse_mem(0, 0x10, 0, SP_REG, TAG(-1));
+                a.sse_mem(0, 0x11, 0, BP_REG, TAG(-1));
+                a.mov_imm32(RAX, JIT_RETURN);
+                epilogue_jumps.push(a.jmp());
+                break;
+            }
+            case OP_POP: a.lea(SP_REG, SP_REG, TAG(-1)); break;
+            case OP_POP_N: a.lea(SP_REG, SP_REG, TAG(-instr[1])); break;
+            case OP_PRINT: helper(jit_print, instr, -1); break;
+            default: return false;
+            }
+        }
+        // a jump past the last instruction
+        native_offsets[len] = a.pos();
+        a.byte(0x0f); // ud2
+        a.byte(0x0b);
+
+        for (i32 i = 0; i < jumps.len(); i++) {
+            if (jumps[i].target > len || native_offsets[jumps[i].target] < 0)
+                return false;
+            a.patch(jumps[i].at, native_offsets[jumps[i].target]);
+        }
+        for (i32 i = 0; i < err_jumps.len(); i++)
+            a.patch(err_jumps[i], a.pos());
+        a.mov_imm32(RAX, JIT_ERR);
+        for (i32 i = 0; i < epilogue_jumps.len(); i++)
+            a.patch(epilogue_jumps[i], a.pos());
+        a.byte(0x48); // add rsp, 8
+        a.byte(0x83);
+        a.byte(0xc4);
+        a.byte(0x08);
+        a.pop(R15);
+        a.pop(R14);
+        a.pop(R13);
+        a.pop(R12);
+        a.pop(RBP);
+        a.pop(RBX);
+        a.byte(0xc3); // ret
+        return true;
+    }
+};
+
+bool jit_compile(VM &vm, FnObj &fn)
+{
+    if (fn.jit)
+        return true;
+    if (fn.jit_unsupported)
+        return false;
+    // native offset of each instruction, -1 for offsets within an instruction
+    Dynarr<i32> native_offsets;
+    for (i32 i = 0; i <= fn.chunk.instrs_len(); i++)
+        native_offsets.push(-1);
+    Jit jit;
+    if (!jit.compile(fn, native_offsets)) {
+        fn.jit_unsupported = true;
+        return false;
+    }
+    if (!vm.code_heap)
+        vm.code_heap = new CodeHeap();
+    const u8 *code = vm.code_heap->add(jit.a.code.raw(), jit.a.code.len());
+    if (!code) {
+        fn.jit_unsupported = true;
+        return false;
+    }
+    if (vm.perf_map)
+        vm.code_heap->add_perf_map(code, jit.a.code.len(), fn);
+    fn.jit = reinterpret_cast<JitFn>(const_cast<u8 *>(code));
+    return true;
+}
+
+#else
+
+bool jit_compile(VM &, FnObj &fn)
+{
+    fn.jit_unsupported = true;
+    return false;
+}
+
+#endif
@@ -0,0 +1,61 @@
+#pragma once
+#include "object.h"
+#include <stdio.h>
+
+// NOTE:
+// baseline jit for x86-64. a fn is compiled the first time it is called, by stitching together a template of machine
+// code for each of its instructions. the native code keeps the frames and the value stack of run_vm: sp and bp live
+// in registers, values are read and written in place and every call pushes a CallFrame. so a fn can stop running
+// natively between any two instructions, save its ip and vm.sp and let run_vm resume it (JIT_DEOPT). this happens
+// when it calls a fn that cannot be compiled.
+// only the fast paths of locals, constants, jumps and arithmetic on numbers are inlined, every other instruction
+// calls a helper that does what run_vm does, and runs the gc if the instruction allocates.
+
+// executable memory for native code. a block is only made writable while code is copied into it
+class CodeHeap {
+    struct Block {
+        u8 *base;
+        u64 cap;
+        u64 used;
+    };
+    Dynarr<Block> blocks_;
+    FILE *perf_map_ = nullptr;
+
+public:
+    ~CodeHeap();
+    // copies code into executable memory, returns nullptr if no memory could be mapped or made executable
+    const u8 *add(const u8 *code, const u64 len);
+    // names the native code of fn in /tmp/perf-<pid>.map, which perf reads to symbolize addresses in code that was
+    // generated at run time. each line is `start size name`, the name is `flood:<fn>:<line>`
+    void add_perf_map(const u8 *code, const u64 len, const FnObj &fn);
+};
+
+// compiles fn to native code if it has not been yet. returns false if it cannot be compiled, e.g. on other
+// architectures than x86-64
+bool jit_compile(VM &vm, FnObj &fn);
+
+// returns true if fn runs natively, which it does once vm.tier_policy promotes it and it could be compiled
+bool tier_up(VM &vm, FnObj &fn);
+
+// helpers for the instructions the native code does not inline, also called by the code of executables built by
+// aot_build (see aot.h). they are called with the stack pointer before the instruction and a pointer to it, and
+// return false if they reported an error
+bool jit_binary(VM &vm, CallFrame *frame, Value *sp, const u8 *instr);
+bool jit_list(VM &vm, CallFrame *frame, Value *sp, const u8 *instr);
+bool jit_list_const(VM &vm, CallFrame *frame, Value *sp, const u8 *instr);
+bool jit_heapval(VM &vm, CallFrame *frame, Value *sp, const u8 *instr);
+bool jit_closure(VM &vm, CallFrame *frame, Value *sp, const u8 *instr);
+bool jit_get_heapval(VM &vm, CallFrame *frame, Value *sp, const u8 *instr);
+bool jit_set_heapval(VM &vm, CallFrame *frame, Value *sp, const u8 *instr);
+bool jit_get_captured(VM &vm, CallFrame *frame, Value *sp, const u8 *instr);
+bool jit_set_captured(VM &vm, CallFrame *frame, Value *sp, const u8 *instr);
+bool jit_get_global(VM &vm, CallFrame *frame, Value *sp, const u8 *instr);
+bool jit_set_global(VM &vm, CallFrame *frame, Value *sp, const u8 *instr);
+bool jit_get_subscr(VM &vm, CallFrame *frame, Value *sp, const u8 *instr);
+bool jit_set_subscr(VM &vm, CallFrame *frame, Value *sp, const u8 *instr);
+bool jit_get_field(VM &vm, CallFrame *frame, Value *sp, const u8 *instr);
+bool jit_set_field(VM &vm, CallFrame *frame, Value *sp, const u8 *instr);
+bool jit_get_method(VM &vm, CallFrame *frame, Value *sp, const u8 *instr);
+bool jit_print(VM &vm, CallFrame *frame, Value *sp, const u8 *instr);
+// calls the callee below the arguments, natively if it can be compiled. the result replaces the callee
+JitStatus jit_call(VM &vm, CallFrame *frame, Value *sp, const u8 *instr);
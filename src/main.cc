@@ -1,58 +1,182 @@
+#include "aot.h"
 #include "compile.h"
+#include "optimize.h"
 #include "parse.h"
 #include "sema.h"
+#include "serialize.h"
+#include <fcntl.h>
+#include <stdlib.h> // for atoi()
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h> // for isatty()
 
+// maps the file at path read only and returns its first byte, or nullptr if it could not be mapped. the file is
+// mapped after a page of zeros and followed by the zeros that fill its last page and another page of zeros, so its
+// bytes are not copied, the source is null terminated on both ends and the scanner can read past it (see SCAN_PADDING)
+static const char *map_source(const char *path, u64 &len, u64 &map_len)
+{
+    const i32 fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return nullptr;
+    }
+    const u64 page = sysconf(_SC_PAGESIZE);
+    len = st.st_size;
+    map_len = page + (len + page - 1) / page * page + page;
+    void *base = mmap(nullptr, map_len, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return nullptr;
+    }
+    char *source = static_cast<char *>(base) + page;
+    if (len > 0 && mmap(source, len, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, map_len);
+        close(fd);
+        return nullptr;
+    }
+    close(fd);
+    return source;
+}
+
+static void unmap_source(const char *source, const u64 map_len)
+{
+    munmap(const_cast<char *>(source) - sysconf(_SC_PAGESIZE), map_len);
+}
+
 int main(int argc, const char **argv)
 {
-    if (argc != 2) {
-        printf("usage: flood script.fl\n");
+    // the builtins are part of images, so they are only defined if the module is compiled
+    VM vm(false);
+    ClosureObj *script = nullptr;
+    // an executable written by `flood build` runs the module embedded in it, whatever its arguments
+    if (read_embedded(vm, script)) {
+        if (script)
+            run_vm(vm, *script);
         return 0;
     }
 
-    FILE *fp = fopen(argv[1], "rb");
-    fseek(fp, 0, SEEK_END);
-    const u64 length = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-    char *buf = new char[length + 2];
-    buf[0] = '\0';
-    buf[length + 1] = '\0';
-    char *source = buf + 1;
-    // TODO check for null bytes
-    fread(source, 1, length, fp);
-    const bool flag_color = isatty(1);
+    const char *path = nullptr;
+    const char *out_path = nullptr;
+    CompileOptions options;
+    const bool flag_build = argc > 1 && strcmp(argv[1], "build") == 0;
+    bool flag_register_vm = false;
+    bool flag_no_cache = false;
+    bool flag_jit = false;
+    bool flag_native = false;
+    bool flag_hot_report = false;
+    bool flag_perf_map = false;
+    i32 jit_threshold = 0;
+    for (i32 i = flag_build ? 2 : 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && flag_build && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (strcmp(argv[i], "--native") == 0 && flag_build) {
+            flag_native = true;
+        } else if (strcmp(argv[i], "--no-peephole") == 0) {
+            options.peephole = false;
+        } else if (strcmp(argv[i], "--inline-threshold") == 0 && i + 1 < argc) {
+            options.inline_threshold = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--inline-report") == 0) {
+            options.inline_report = true;
+        } else if (strcmp(argv[i], "--register-vm") == 0) {
+            flag_register_vm = true;
+        } else if (strcmp(argv[i], "--no-cache") == 0) {
+            flag_no_cache = true;
+        } else if (strcmp(argv[i], "--jit") == 0) {
+            flag_jit = true;
+        } else if (strcmp(argv[i], "--jit-threshold") == 0 && i + 1 < argc) {
+            flag_jit = true;
+            jit_threshold = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--hot-report") == 0) {
+            flag_hot_report = true;
+        } else if (strcmp(argv[i], "--perf-map") == 0) {
+            // only native code is named in the map
+            flag_jit = true;
+            flag_perf_map = true;
+        } else if (path == nullptr) {
+            path = argv[i];
+        } else {
+            path = nullptr;
+            break;
+        }
+    }
+    // the executable holds stack instructions
+    if (path == nullptr || (flag_build && (out_path == nullptr || flag_register_vm))) {
+        printf("usage: flood [--no-peephole] [--inline-threshold n] [--inline-report] [--register-vm] [--no-cache] "
+               "[--jit] [--jit-threshold n] [--hot-report] [--perf-map] script.fl\n"
+               "       flood build [--native] [--no-peephole] [--inline-threshold n] [--no-cache] script.fl -o app\n");
+        return 0;
+    }
 
-    Dynarr<ErrMsg> errarr;
-    Arena arena;
-    ModuleNode &node = parse(source, arena, errarr);
-    if (errarr.len() > 0) {
-        print_errarr(errarr, flag_color);
-        delete[] buf;
-        fclose(fp);
+    u64 length = 0;
+    u64 map_len = 0;
+    // TODO check for null bytes
+    const char *source = map_source(path, length, map_len);
+    if (source == nullptr) {
+        fprintf(stderr, "could not read %s\n", path);
         return 1;
     }
+    const bool flag_color = isatty(1);
+    // the cache holds stack instructions, and is bypassed when the compiler must run to report what it inlines, or
+    // the module must be compiled the way a native executable compiles it when it starts (see aot.h)
+    const bool flag_cache = !flag_no_cache && !flag_register_vm && !options.inline_report && !flag_native;
+    const u64 key = image_key(source, length, options);
 
-    analyze(node, errarr, arena);
+    if (!flag_cache || !read_cache(vm, path, key, script)) {
+        vm.define_builtins();
+        Dynarr<ErrMsg> errarr;
+        Arena arena;
+        ModuleNode &node = parse(source, arena, errarr);
+        if (errarr.len() > 0) {
+            print_errarr(errarr, flag_color);
+            unmap_source(source, map_len);
+            return 1;
+        }
 
-    if (errarr.len() > 0) {
-        print_errarr(errarr, flag_color);
-        delete[] buf;
-        fclose(fp);
-        return 1;
+        analyze(node, vm, errarr, arena);
+
+        if (errarr.len() > 0) {
+            print_errarr(errarr, flag_color);
+            unmap_source(source, map_len);
+            return 1;
+        }
+
+        optimize(node, arena);
+        script = flag_register_vm ? compile_reg(vm, node, errarr) : compile(vm, node, errarr, options);
+        if (errarr.len() > 0) {
+            print_errarr(errarr, flag_color);
+            unmap_source(source, map_len);
+            return 1;
+        }
+        if (flag_cache)
+            write_cache(vm, path, script, key);
     }
 
-    VM vm;
-    ClosureObj *script = compile(vm, node, errarr);
-    if (errarr.len() > 0) {
-        print_errarr(errarr, flag_color);
-        delete[] buf;
-        fclose(fp);
-        return 1;
+    if (flag_build) {
+        const bool ok =
+            flag_native ? aot_build(vm, source, length, options, out_path) : write_executable(vm, out_path, script);
+        if (!ok)
+            fprintf(stderr, "could not write %s\n", out_path);
+        unmap_source(source, map_len);
+        return ok ? 0 : 1;
     }
 
-    if (script)
+    vm.jit = flag_jit;
+    vm.perf_map = flag_perf_map;
+    // fns are compiled once they are called n times instead of on their first call
+    if (jit_threshold > 0) {
+        vm.tier_policy = tier_hot;
+        vm.hot_threshold = jit_threshold;
+    }
+    if (script && flag_register_vm)
+        run_reg_vm(vm, *script);
+    else if (script)
         run_vm(vm, *script);
+    if (flag_hot_report)
+        print_hot_fns(vm, 10);
 
-    delete[] buf;
-    fclose(fp);
+    unmap_source(source, map_len);
 }
@@ -0,0 +1,214 @@
+#include "object.h"
+
+static ListKind kind_of(const Value *vals, const i32 cnt)
+{
+    bool all_num = true;
+    bool all_bool = cnt > 0;
+    for (i32 i = 0; i < cnt; i++) {
+        all_num = all_num && IS_NUM(vals[i]);
+        all_bool = all_bool && IS_BOOL(vals[i]);
+    }
+    if (all_num)
+        return LIST_NUM;
+    if (all_bool)
+        return LIST_BOOL;
+    return LIST_VAL;
+}
+
+ListObj::ListObj(Dynarr<Value> &&vals) : Obj(OBJ_LIST), kind(kind_of(vals.raw(), vals.len()))
+{
+    if (kind == LIST_VAL) {
+        new (&this->vals) Dynarr<Value>(move(vals));
+        return;
+    }
+    init_storage(kind);
+    for (i32 i = 0; i < vals.len(); i++)
+        push(vals[i]);
+}
+
+ListObj::ListObj(const Value *vals, const i32 cnt) : Obj(OBJ_LIST), kind(kind_of(vals, cnt))
+{
+    init_storage(kind);
+    for (i32 i = 0; i < cnt; i++)
+        push(vals[i]);
+}
+
+ListObj::ListObj(const ListObj *tmpl) : Obj(OBJ_LIST), kind(tmpl->kind)
+{
+    // clang-format off
+    switch (kind) {
+    case LIST_NUM:  new (&nums) Dynarr<double>(tmpl->nums.raw(), tmpl->nums.len()); break;
+    case LIST_BOOL: new (&bools) Dynarr<bool>(tmpl->bools.raw(), tmpl->bools.len()); break;
+    case LIST_VAL:  new (&vals) Dynarr<Value>(tmpl->vals.raw(), tmpl->vals.len()); break;
+    }
+    // clang-format on
+}
+
+ListObj::~ListObj()
+{
+    drop_storage();
+}
+
+void ListObj::init_storage(const ListKind kind)
+{
+    this->kind = kind;
+    // clang-format off
+    switch (kind) {
+    case LIST_NUM:  new (&nums) Dynarr<double>(); break;
+    case LIST_BOOL: new (&bools) Dynarr<bool>(); break;
+    case LIST_VAL:  new (&vals) Dynarr<Value>(); break;
+    }
+    // clang-format on
+}
+
+void ListObj::drop_storage()
+{
+    // clang-format off
+    switch (kind) {
+    case LIST_NUM:  nums.~Dynarr<double>(); break;
+    case LIST_BOOL: bools.~Dynarr<bool>(); break;
+    case LIST_VAL:  vals.~Dynarr<Value>(); break;
+    }
+    // clang-format on
+}
+
+void ListObj::to_generic()
+{
+    Dynarr<Value> generic;
+    for (i32 i = 0; i < len(); i++)
+        generic.push(get(i));
+    drop_storage();
+    kind = LIST_VAL;
+    new (&vals) Dynarr<Value>(move(generic));
+}
+
+i32 ListObj::len() const
+{
+    // clang-format off
+    switch (kind) {
+    case LIST_NUM:  return nums.len();
+    case LIST_BOOL: return bools.len();
+    case LIST_VAL:  return vals.len();
+    }
+    // clang-format on
+    return 0;
+}
+
+Value ListObj::get(const i32 idx) const
+{
+    // clang-format off
+    switch (kind) {
+    case LIST_NUM:  return MK_NUM(nums[idx]);
+    case LIST_BOOL: return MK_BOOL(bools[idx]);
+    case LIST_VAL:  return vals[idx];
+    }
+    // clang-format on
+    return MK_NULL;
+}
+
+void ListObj::set(const i32 idx, const Value val)
+{
+    if (kind == LIST_NUM && IS_NUM(val)) {
+        nums[idx] = AS_NUM(val);
+    } else if (kind == LIST_BOOL && IS_BOOL(val)) {
+        bools[idx] = AS_BOOL(val);
+    } else {
+        if (kind != LIST_VAL)
+            to_generic();
+        vals[idx] = val;
+    }
+}
+
+void ListObj::push(const Value val)
+{
+    if (len() == 0 && kind != LIST_VAL) {
+        const ListKind new_kind = kind_of(&val, 1);
+        if (new_kind != kind) {
+            drop_storage();
+            init_storage(new_kind);
+        }
+    }
+    if (kind == LIST_NUM && IS_NUM(val)) {
+        nums.push(AS_NUM(val));
+    } else if (kind == LIST_BOOL && IS_BOOL(val)) {
+        bools.push(AS_BOOL(val));
+    } else {
+        if (kind != LIST_VAL)
+            to_generic();
+        vals.push(val);
+    }
+}
+
+void ListObj::pop()
+{
+    // clang-format off
+    switch (kind) {
+    case LIST_NUM:  nums.pop(); break;
+    case LIST_BOOL: bools.pop(); break;
+    case LIST_VAL:  vals.pop(); break;
+    }
+    // clang-format on
+}
+
+const String &StringObj::flat()
+{
+    if (kind == STRING_FLAT)
+        return str;
+    if (kind == STRING_SLICE) {
+        str = String(parent->str.chars() + offset, len);
+        // the parent is no longer reachable through this string and can be collected
+        parent = nullptr;
+        offset = 0;
+        kind = STRING_FLAT;
+        return str;
+    }
+    // ropes built by repeated appends are deep, so walk them with an explicit stack rather than recursing
+    char *chars = new char[len];
+    i32 pos = 0;
+    Dynarr<StringObj *> stack;
+    stack.push(this);
+    while (stack.len() > 0) {
+        StringObj *node = stack[stack.len() - 1];
+        stack.pop();
+        if (node->kind == STRING_ROPE) {
+            stack.push(node->rhs);
+            stack.push(node->lhs);
+        } else {
+            memcpy(chars + pos, node->data(), node->len);
+            pos += node->len;
+        }
+    }
+    str = String(chars, len);
+    delete[] chars;
+    // the children are no longer reachable through this string and can be collected
+    lhs = nullptr;
+    rhs = nullptr;
+    kind = STRING_FLAT;
+    return str;
+}
+
+StringObj *concat_strings(VM &vm, StringObj *lhs, StringObj *rhs)
+{
+    if (lhs->len == 0)
+        return rhs;
+    if (rhs->len == 0)
+        return lhs;
+    const i32 len = lhs->len + rhs->len;
+    if (len >= ROPE_MIN_LEN)
+        return alloc<StringObj>(vm, lhs, rhs);
+    char chars[ROPE_MIN_LEN];
+    memcpy(chars, lhs->data(), lhs->len);
+    memcpy(chars + lhs->len, rhs->data(), rhs->len);
+    return alloc<StringObj>(vm, String(chars, len));
+}
+
+StringObj *slice_string(VM &vm, StringObj *str, const i32 start, const i32 end)
+{
+    if (start == 0 && end == str->len)
+        return str;
+    // slices always point into a flat string so that reading through them is a single indirection
+    if (str->kind == STRING_SLICE)
+        return alloc<StringObj>(vm, str->parent, str->offset + start, end - start);
+    str->flat();
+    return alloc<StringObj>(vm, str, start, end - start);
+}
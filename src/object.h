@@ -1,5 +1,6 @@
 #pragma once
 #include "../libflood/dynarr.h"
+#include "../libflood/ringbuf.h"
 #include "../libflood/string.h"
 #include "chunk.h"
 #include "gc.h"
@@ -15,6 +16,11 @@ enum ObjTag {
     OBJ_INSTANCE,
     OBJ_METHOD,
     OBJ_FOREIGN_METHOD,
+    OBJ_STRING_BUILDER,
+    OBJ_MAP,
+    OBJ_SET,
+    OBJ_DEQUE,
+    OBJ_F64ARRAY,
 };
 
 struct Obj {
@@ -28,7 +34,7 @@ struct Obj {
 
 struct ClassObj;
 
-typedef InterpResult (*ForeignFnWrapper)(Value *value);
+typedef InterpResult (*ForeignFnWrapper)(VM &vm, Value *value);
 
 struct StringObj;
 
@@ -46,7 +52,26 @@ struct FnObj : public Obj {
     StringObj *name;
     Chunk chunk;
     i32 arity;
-    FnObj(StringObj *name, Chunk &&chunk, i32 arity) : Obj(OBJ_FN), name(name), chunk(move(chunk)), arity(arity) {}
+    i32 reg_cnt;          // size of the register window if chunk holds register code
+    JitFn jit;            // native code of chunk, see jit_compile
+    bool jit_unsupported; // jit_compile failed, the fn is always interpreted
+    // hotness counters, see TierPolicy. calls are counted in every tier, jumps only by the interpreters
+    u64 call_cnt;
+    Dynarr<u32> jump_cnts; // times each offset of chunk was jumped to, empty until a jump is taken
+    FnObj(StringObj *name, Chunk &&chunk, i32 arity)
+        : Obj(OBJ_FN), name(name), chunk(move(chunk)), arity(arity), reg_cnt(0), jit(nullptr),
+          jit_unsupported(false), call_cnt(0)
+    {
+    }
+
+    void count_jump(const u8 *target)
+    {
+        if (jump_cnts.len() == 0) {
+            for (i32 i = 0; i <= chunk.instrs_len(); i++)
+                jump_cnts.push(0);
+        }
+        jump_cnts[target - chunk.instrs()]++;
+    }
 };
 
 struct ForeignMethodObj : public Obj {
@@ -75,14 +100,115 @@ struct ClosureObj : public Obj {
     }
 };
 
+enum ListKind : u8 { LIST_NUM, LIST_BOOL, LIST_VAL };
+
+// a list stores its elements unboxed while they are all numbers (LIST_NUM) or all booleans (LIST_BOOL).
+// storing any other value moves it to LIST_VAL, and it never moves back. an empty list may change
+// kind freely, so the first push decides it
 struct ListObj : public Obj {
-    Dynarr<Value> vals;
-    ListObj(Dynarr<Value> &&vals) : Obj(OBJ_LIST), vals(move(vals)) {}
+    ListKind kind;
+    union {
+        Dynarr<double> nums;
+        Dynarr<bool> bools;
+        Dynarr<Value> vals;
+    };
+    ListObj(Dynarr<Value> &&vals);
+    ListObj(const Value *vals, const i32 cnt);
+    // copy of a list built at compile time, see OP_LIST_CONST
+    ListObj(const ListObj *tmpl);
+    ~ListObj();
+
+    i32 len() const;
+    Value get(const i32 idx) const;
+    void set(const i32 idx, const Value val);
+    void push(const Value val);
+    void pop();
+
+private:
+    void init_storage(const ListKind kind);
+    void drop_storage();
+    void to_generic();
 };
 
+// concatenations shorter than this are copied eagerly rather than building a rope node
+#define ROPE_MIN_LEN (32)
+
+enum StringKind : u8 { STRING_FLAT, STRING_ROPE, STRING_SLICE };
+
+// a string is one of
+//      flat:  its characters live in str
+//      rope:  the concatenation of lhs and rhs
+//      slice: len characters of the flat string parent, starting at offset
+// ropes are flattened on first indexed access, comparison or hashing. slices read through to their
+// parent and are only materialized when they must be NUL-terminated or hashed
 struct StringObj : public Obj {
+    StringKind kind;
     String str;
-    StringObj(String &&str) : Obj(OBJ_STRING), str(move(str)) {}
+    StringObj *lhs;
+    StringObj *rhs;
+    StringObj *parent;
+    i32 offset;
+    i32 len;
+    StringObj(String &&str)
+        : Obj(OBJ_STRING), kind(STRING_FLAT), str(move(str)), lhs(nullptr), rhs(nullptr), parent(nullptr), offset(0)
+        , len(this->str.len())
+    {
+    }
+    StringObj(StringObj *lhs, StringObj *rhs)
+        : Obj(OBJ_STRING), kind(STRING_ROPE), lhs(lhs), rhs(rhs), parent(nullptr), offset(0), len(lhs->len + rhs->len)
+    {
+    }
+    // precondition: parent is flat
+    StringObj(StringObj *parent, const i32 offset, const i32 len)
+        : Obj(OBJ_STRING), kind(STRING_SLICE), lhs(nullptr), rhs(nullptr), parent(parent), offset(offset), len(len)
+    {
+    }
+
+    // characters of the string, not NUL-terminated if the string is a slice
+    const char *data()
+    {
+        if (kind == STRING_SLICE)
+            return parent->str.chars() + offset;
+        return flat().chars();
+    }
+    const String &flat();
+};
+
+StringObj *concat_strings(VM &vm, StringObj *lhs, StringObj *rhs);
+
+// precondition: 0 <= start <= end <= str->len
+StringObj *slice_string(VM &vm, StringObj *str, const i32 start, const i32 end);
+
+struct StringBuilderObj : public Obj {
+    Dynarr<char> chars;
+    StringBuilderObj() : Obj(OBJ_STRING_BUILDER) {}
+};
+
+struct MapObj : public Obj {
+    ValMap map;
+    MapObj() : Obj(OBJ_MAP) {}
+};
+
+// a set is a map whose values are unused
+struct SetObj : public Obj {
+    ValMap map;
+    SetObj() : Obj(OBJ_SET) {}
+};
+
+struct DequeObj : public Obj {
+    Ringbuf<Value> vals;
+    DequeObj() : Obj(OBJ_DEQUE) {}
+};
+
+// fixed-length array of unboxed doubles, the bulk operations on it run the kernels in f64kernels.h
+struct F64ArrayObj : public Obj {
+    i32 len;
+    double *vals;
+    F64ArrayObj(const i32 len) : Obj(OBJ_F64ARRAY), len(len), vals(new double[len]()) {}
+    ~F64ArrayObj()
+    {
+        delete[] vals;
+    }
 };
 
 struct ClassObj : public Obj {
@@ -118,6 +244,11 @@ static inline bool is_obj_tag(Value val, enum ObjTag tag)
 #define IS_INSTANCE(val)       (is_obj_tag(val, OBJ_INSTANCE))
 #define IS_METHOD(val)         (is_obj_tag(val, OBJ_METHOD))
 #define IS_FOREIGN_METHOD(val) (is_obj_tag(val, OBJ_FOREIGN_METHOD))
+#define IS_STRING_BUILDER(val) (is_obj_tag(val, OBJ_STRING_BUILDER))
+#define IS_MAP(val)            (is_obj_tag(val, OBJ_MAP))
+#define IS_SET(val)            (is_obj_tag(val, OBJ_SET))
+#define IS_DEQUE(val)          (is_obj_tag(val, OBJ_DEQUE))
+#define IS_F64ARRAY(val)       (is_obj_tag(val, OBJ_F64ARRAY))
 
 #define AS_FOREIGN_FN(val)     (static_cast<ForeignFnObj *>(AS_OBJ(val)))
 #define AS_FN(val)             (static_cast<FnObj *>(AS_OBJ(val)))
@@ -129,3 +260,8 @@ static inline bool is_obj_tag(Value val, enum ObjTag tag)
 #define AS_INSTANCE(val)       (static_cast<InstanceObj *>(AS_OBJ(val)))
 #define AS_METHOD(val)         (static_cast<MethodObj *>(AS_OBJ(val)))
 #define AS_FOREIGN_METHOD(val) (static_cast<ForeignMethodObj *>(AS_OBJ(val)))
+#define AS_STRING_BUILDER(val) (static_cast<StringBuilderObj *>(AS_OBJ(val)))
+#define AS_MAP(val)            (static_cast<MapObj *>(AS_OBJ(val)))
+#define AS_SET(val)            (static_cast<SetObj *>(AS_OBJ(val)))
+#define AS_DEQUE(val)          (static_cast<DequeObj *>(AS_OBJ(val)))
+#define AS_F64ARRAY(val)       (static_cast<F64ArrayObj *>(AS_OBJ(val)))
@@ -0,0 +1,222 @@
+#include "optimize.h"
+#include "value.h"
+#include <math.h>
+
+// null, booleans and numbers. string atoms are left alone since every use allocates a new string
+static bool is_const(const Node &node)
+{
+    return node.tag == NODE_ATOM && static_cast<const AtomNode &>(node).atom_tag != TOKEN_STRING;
+}
+
+// precondition: is_const(node)
+static Value const_val(const Node &node)
+{
+    const AtomNode &atom = static_cast<const AtomNode &>(node);
+    // clang-format off
+    switch (atom.atom_tag) {
+    case TOKEN_TRUE:   return MK_BOOL(true);
+    case TOKEN_FALSE:  return MK_BOOL(false);
+    case TOKEN_NUMBER: return MK_NUM(atom.num);
+    default:           return MK_NULL;
+    }
+    // clang-format on
+}
+
+// folds constant expressions, replaces uses of never-assigned locals initialized to a constant with the constant,
+// and replaces `if` statements with a constant condition by the branch that is taken.
+// expressions whose evaluation fails at runtime (e.g. `1 + true`) are left for the VM to report
+struct FoldConstants final : public AstVisitor {
+    Arena &arena;
+    Node *folded; // result of the last call to fold
+
+    FoldConstants(Arena &arena) : arena(arena), folded(nullptr) {}
+
+    Node *fold(Node *node)
+    {
+        folded = node;
+        visit_expr(*node);
+        return folded;
+    }
+
+    Node *make_const(const Span span, const Value val)
+    {
+        if (IS_NUM(val))
+            return alloc<AtomNode>(arena, span, AS_NUM(val));
+        if (IS_BOOL(val))
+            return alloc<AtomNode>(arena, span, AS_BOOL(val) ? TOKEN_TRUE : TOKEN_FALSE);
+        return alloc<AtomNode>(arena, span, TOKEN_NULL);
+    }
+
+    void visit_ident(IdentNode &node) override
+    {
+        DeclNode *decl = node.decl;
+        while (decl->tag == NODE_CAPTURE_DECL)
+            decl = static_cast<CaptureDecl *>(decl)->decl_original;
+        if (decl->tag != NODE_VAR_DECL || decl->flags & FLAG_ASSIGNED)
+            return;
+        // the initializer was folded when the declaration was visited
+        const Node *init = static_cast<VarDeclNode *>(decl)->init;
+        if (init && is_const(*init))
+            folded = make_const(node.span, const_val(*init));
+    }
+
+    void visit_list(ListNode &node) override
+    {
+        for (i32 i = 0; i < node.cnt; i++)
+            node.items[i] = fold(node.items[i]);
+        folded = &node;
+    }
+
+    void visit_unary(UnaryNode &node) override
+    {
+        node.rhs = fold(node.rhs);
+        folded = &node;
+        if (!is_const(*node.rhs))
+            return;
+        const Value val = const_val(*node.rhs);
+        if (node.op_tag == TOKEN_MINUS && IS_NUM(val))
+            folded = make_const(node.span, MK_NUM(-AS_NUM(val)));
+        else if (node.op_tag == TOKEN_NOT && IS_BOOL(val))
+            folded = make_const(node.span, MK_BOOL(!AS_BOOL(val)));
+    }
+
+    void visit_binary(BinaryNode &node) override
+    {
+        node.lhs = fold(node.lhs);
+        node.rhs = fold(node.rhs);
+        folded = &node;
+        const TokenTag op_tag = node.op_tag;
+        if (op_tag == TOKEN_AND || op_tag == TOKEN_OR) {
+            // `true and x` and `false or x` are x, `false and x` and `true or x` are the lhs
+            if (is_const(*node.lhs) && IS_BOOL(const_val(*node.lhs)))
+                folded = AS_BOOL(const_val(*node.lhs)) == (op_tag == TOKEN_AND) ? node.rhs : node.lhs;
+            return;
+        }
+        if (!is_const(*node.lhs) || !is_const(*node.rhs))
+            return;
+        const Value lhs = const_val(*node.lhs);
+        const Value rhs = const_val(*node.rhs);
+        if (op_tag == TOKEN_EQEQ || op_tag == TOKEN_NEQ) {
+            folded = make_const(node.span, MK_BOOL(val_eq(lhs, rhs) == (op_tag == TOKEN_EQEQ)));
+            return;
+        }
+        if (!IS_NUM(lhs) || !IS_NUM(rhs))
+            return;
+        const double a = AS_NUM(lhs);
+        const double b = AS_NUM(rhs);
+        // clang-format off
+        switch (op_tag) {
+        case TOKEN_PLUS:        folded = make_const(node.span, MK_NUM(a + b)); break;
+        case TOKEN_MINUS:       folded = make_const(node.span, MK_NUM(a - b)); break;
+        case TOKEN_STAR:        folded = make_const(node.span, MK_NUM(a * b)); break;
+        case TOKEN_SLASH:       folded = make_const(node.span, MK_NUM(a / b)); break;
+        case TOKEN_SLASH_SLASH: folded = make_const(node.span, MK_NUM(floor(a / b))); break;
+        case TOKEN_PERCENT:     folded = make_const(node.span, MK_NUM(fmod(a, b))); break;
+        case TOKEN_LT:          folded = make_const(node.span, MK_BOOL(a < b)); break;
+        case TOKEN_LEQ:         folded = make_const(node.span, MK_BOOL(a <= b)); break;
+        case TOKEN_GT:          folded = make_const(node.span, MK_BOOL(a > b)); break;
+        case TOKEN_GEQ:         folded = make_const(node.span, MK_BOOL(a >= b)); break;
+        default:                break;
+        }
+        // clang-format on
+    }
+
+    void visit_selector(SelectorNode &node) override
+    {
+        node.lhs = fold(node.lhs);
+        folded = &node;
+    }
+
+    void visit_subscr(SubscrNode &node) override
+    {
+        node.lhs = fold(node.lhs);
+        node.rhs = fold(node.rhs);
+        folded = &node;
+    }
+
+    void visit_assign(AssignNode &node) override
+    {
+        // the target itself is never replaced, only the expressions inside it
+        if (node.lhs->tag == NODE_SUBSCR) {
+            SubscrNode &lhs = static_cast<SubscrNode &>(*node.lhs);
+            lhs.lhs = fold(lhs.lhs);
+            lhs.rhs = fold(lhs.rhs);
+        } else if (node.lhs->tag == NODE_SELECTOR) {
+            SelectorNode &lhs = static_cast<SelectorNode &>(*node.lhs);
+            lhs.lhs = fold(lhs.lhs);
+        }
+        node.rhs = fold(node.rhs);
+        folded = &node;
+    }
+
+    void visit_call(CallNode &node) override
+    {
+        node.lhs = fold(node.lhs);
+        for (i32 i = 0; i < node.arity; i++)
+            node.args[i] = fold(node.args[i]);
+        folded = &node;
+    }
+
+    void visit_var_decl(VarDeclNode &node) override
+    {
+        if (node.init)
+            node.init = fold(node.init);
+    }
+
+    void visit_expr_stmt(ExprStmtNode &node) override
+    {
+        node.expr = fold(node.expr);
+    }
+
+    void visit_return(ReturnNode &node) override
+    {
+        if (node.expr)
+            node.expr = fold(node.expr);
+    }
+
+    void visit_print(PrintNode &node) override
+    {
+        node.expr = fold(node.expr);
+    }
+
+    void visit_if(IfNode &node) override
+    {
+        node.cond = fold(node.cond);
+        visit_block(*node.thn);
+        if (node.els)
+            visit_block(*node.els);
+    }
+
+    // returns the branch of the `if` that is always taken, or the `if` itself
+    Node *prune_if(IfNode &node)
+    {
+        if (!is_const(*node.cond) || !IS_BOOL(const_val(*node.cond)))
+            return &node;
+        if (AS_BOOL(const_val(*node.cond)))
+            return node.thn;
+        if (node.els)
+            return node.els;
+        return alloc<BlockNode>(arena, node.span, nullptr, 0, false);
+    }
+
+    void visit_block(BlockNode &node) override
+    {
+        for (i32 i = 0; i < node.cnt; i++) {
+            visit_stmt(*node.stmts[i]);
+            if (node.stmts[i]->tag == NODE_IF)
+                node.stmts[i] = prune_if(static_cast<IfNode &>(*node.stmts[i]));
+        }
+    }
+
+    void visit(ModuleNode &node)
+    {
+        for (i32 i = 0; i < node.cnt; i++)
+            visit_stmt(*node.decls[i]);
+    }
+};
+
+void optimize(ModuleNode &node, Arena &arena)
+{
+    FoldConstants pass(arena);
+    pass.visit(node);
+}
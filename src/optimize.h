@@ -0,0 +1,6 @@
+#pragma once
+#include "../libflood/arena.h"
+#include "ast.h"
+
+// precondition: node was analyzed without errors
+void optimize(ModuleNode &node, Arena &arena);
@@ -132,25 +132,61 @@ void Parser::recover_block()
     }
 }
 
+i32 Parser::nodes_len() const
+{
+    return nodes_.len();
+}
+
+void Parser::push_node(Node *node)
+{
+    nodes_.push(node);
+}
+
+i32 Parser::spans_len() const
+{
+    return spans_.len();
+}
+
+void Parser::push_span(Span span)
+{
+    spans_.push(span);
+}
+
+Span Parser::span_at(const i32 idx) const
+{
+    return spans_[idx];
+}
+
+void Parser::drop_spans(const i32 base)
+{
+    while (spans_.len() > base)
+        spans_.pop();
+}
+
+Span *Parser::pop_spans(const i32 base)
+{
+    Span *spans = copy_slice(arena_, spans_.raw() + base, spans_.len() - base);
+    drop_spans(base);
+    return spans;
+}
+
 static Node *parse_expr(Parser &p, const i32 prec_lvl);
 static BlockNode *parse_block(Parser &p, const bool is_fn_body);
 
 // precondition: `[` or `(` token consumed
-// parses arguments and fills the ptr array provided
-static Dynarr<Node *> parse_arg_list(Parser &p, const TokenTag tag_right)
+// parses arguments and pushes them on the node stack of the parser
+static void parse_arg_list(Parser &p, const TokenTag tag_right)
 {
-    Dynarr<Node *> nodearr;
     while (p.at().tag != tag_right && p.at().tag != TOKEN_EOF) {
         // breaking early helps when the right token is missing
         if (!expr_first(p.at().tag)) {
             p.emit_err("expected expression");
             break;
         }
-        nodearr.push(parse_expr(p, 1));
+        p.push_node(parse_expr(p, 1));
         if (p.at().tag != tag_right)
             p.expect(TOKEN_COMMA, "expected `,`");
     }
-    return nodearr;
 }
 
 static Node *parse_expr(Parser &p, const i32 prec_lvl)
@@ -167,10 +203,11 @@ static Node *parse_expr(Parser &p, const i32 prec_lvl)
     case TOKEN_STRING: lhs = alloc<AtomNode>(p.arena(), token.span, token.tag); break;
     case TOKEN_IDENTIFIER: lhs = alloc<IdentNode>(p.arena(), token.span); break;
     case TOKEN_L_SQUARE: {
-        Dynarr<Node *> nodearr = parse_arg_list(p, TOKEN_R_SQUARE);
+        const i32 base = p.nodes_len();
+        parse_arg_list(p, TOKEN_R_SQUARE);
         p.expect(TOKEN_R_SQUARE, "expected `]`");
-        const i32 cnt = nodearr.len();
-        Node *const *const items = move_dynarr(p.arena(), move(nodearr));
+        const i32 cnt = p.nodes_len() - base;
+        Node **const items = p.pop_nodes<Node>(base);
         lhs = alloc<ListNode>(p.arena(), token.span, items, cnt);
         break;
     }
@@ -205,10 +242,11 @@ static Node *parse_expr(Parser &p, const i32 prec_lvl)
         // parse fn call
         if (p.eat(TOKEN_L_PAREN)) {
             const Span fn_call_span = p.prev().span;
-            Dynarr<Node *> nodearr = parse_arg_list(p, TOKEN_R_PAREN);
+            const i32 base = p.nodes_len();
+            parse_arg_list(p, TOKEN_R_PAREN);
             p.expect(TOKEN_R_PAREN, "expected `)`");
-            const i32 cnt = nodearr.len();
-            Node *const *const args = move_dynarr(p.arena(), move(nodearr));
+            const i32 cnt = p.nodes_len() - base;
+            Node **const args = p.pop_nodes<Node>(base);
             lhs = alloc<CallNode>(p.arena(), fn_call_span, lhs, args, cnt);
             continue;
         }
@@ -273,10 +311,10 @@ static FnDeclNode *parse_fn_decl(Parser &p, const bool is_method)
     const Span span = p.at().span;
     p.expect(TOKEN_IDENTIFIER, "expected identifier");
     p.expect(TOKEN_L_PAREN, "expected `(`");
-    Dynarr<VarDeclNode> paramarr;
+    const i32 base = p.spans_len();
     while (p.at().tag != TOKEN_R_PAREN && p.at().tag != TOKEN_EOF) {
         if (p.eat(TOKEN_IDENTIFIER)) {
-            paramarr.push(VarDeclNode(p.prev().span, nullptr));
+            p.push_span(p.prev().span);
             if (p.at().tag != TOKEN_R_PAREN)
                 p.expect(TOKEN_COMMA, "expected `,`");
         } else if (p.at().tag == TOKEN_FN || p.at().tag == TOKEN_CLASS || p.at().tag == TOKEN_L_BRACE ||
@@ -288,10 +326,14 @@ static FnDeclNode *parse_fn_decl(Parser &p, const bool is_method)
         }
     }
     if (is_method)
-        paramarr.push(VarDeclNode(Span{"self", 4, -1}, nullptr));
+        p.push_span(Span{"self", 4, -1});
     p.expect(TOKEN_R_PAREN, "expected `)`");
-    const i32 arity = paramarr.len();
-    VarDeclNode *const params = move_dynarr(p.arena(), move(paramarr));
+    const i32 arity = p.spans_len() - base;
+    VarDeclNode *const params =
+        reinterpret_cast<VarDeclNode *>(p.arena().push(arity * sizeof(VarDeclNode), alignof(VarDeclNode)));
+    for (i32 i = 0; i < arity; i++)
+        new (params + i) VarDeclNode(p.span_at(base + i), nullptr);
+    p.drop_spans(base);
     BlockNode *const body = parse_block(p, true);
     return alloc<FnDeclNode>(p.arena(), span, body, params, arity);
 }
@@ -303,18 +345,18 @@ static ClassDeclNode *parse_class_decl(Parser &p)
     const Span span = p.prev().span;
     p.expect(TOKEN_L_BRACE, "expected `{`");
 
-    Dynarr<FnDeclNode *> nodearr;
+    const i32 base = p.nodes_len();
     while (p.at().tag != TOKEN_R_BRACE && p.at().tag != TOKEN_EOF) {
         if (p.eat(TOKEN_FN)) {
             p.set_panic(false);
-            nodearr.push(parse_fn_decl(p, true));
+            p.push_node(parse_fn_decl(p, true));
         } else {
             p.advance_with_err("expected method declaration");
         }
     }
     p.expect(TOKEN_R_BRACE, "expected `}`");
-    const i32 cnt = nodearr.len();
-    return alloc<ClassDeclNode>(p.arena(), span, move_dynarr(p.arena(), move(nodearr)), cnt);
+    const i32 cnt = p.nodes_len() - base;
+    return alloc<ClassDeclNode>(p.arena(), span, p.pop_nodes<FnDeclNode>(base), cnt);
 }
 
 // precondition: `return` token consumed
@@ -343,7 +385,7 @@ static BlockNode *parse_block(Parser &p, const bool is_fn_body)
     const Span span = p.at().span;
     if (!p.expect(TOKEN_L_BRACE, "expected `{`"))
         return nullptr;
-    Dynarr<Node *> nodearr;
+    const i32 base = p.nodes_len();
     while (p.at().tag != TOKEN_R_BRACE && p.at().tag != TOKEN_EOF) {
         Node *node = nullptr;
         if (p.at().tag == TOKEN_L_BRACE) {
@@ -365,13 +407,13 @@ static BlockNode *parse_block(Parser &p, const bool is_fn_body)
         } else {
             p.advance_with_err("expected statement");
         }
-        nodearr.push(node);
+        p.push_node(node);
         if (p.panic())
             p.recover_block();
     }
     p.expect(TOKEN_R_BRACE, "expected `}`");
-    const i32 cnt = nodearr.len();
-    Node *const *const stmts = move_dynarr(p.arena(), move(nodearr));
+    const i32 cnt = p.nodes_len() - base;
+    Node **const stmts = p.pop_nodes<Node>(base);
     return alloc<BlockNode>(p.arena(), span, stmts, cnt, is_fn_body);
 }
 
@@ -379,42 +421,42 @@ static BlockNode *parse_block(Parser &p, const bool is_fn_body)
 static ImportNode *parse_import(Parser &p)
 {
     const Span span = p.prev().span;
-    Dynarr<Span> parts;
+    const i32 base = p.spans_len();
     p.expect(TOKEN_IDENTIFIER, "expected identifier");
-    parts.push(p.prev().span);
+    p.push_span(p.prev().span);
     while (p.eat(TOKEN_SLASH)) {
         p.expect(TOKEN_IDENTIFIER, "expected identifier");
-        parts.push(p.prev().span);
+        p.push_span(p.prev().span);
     }
     Span *alias = nullptr;
     if (p.eat(TOKEN_AS)) {
         p.expect(TOKEN_IDENTIFIER, "expected identifier");
         alias = alloc<Span>(p.arena(), p.prev().span);
     }
-    const i32 cnt = parts.len();
+    const i32 cnt = p.spans_len() - base;
     p.expect(TOKEN_SEMI, "expected `;`");
-    return alloc<ImportNode>(p.arena(), span, move_dynarr(p.arena(), move(parts)), cnt, alias);
+    return alloc<ImportNode>(p.arena(), span, p.pop_spans(base), cnt, alias);
 }
 
 static ModuleNode &parse_file(Parser &p)
 {
-    Dynarr<DeclNode *> nodearr;
+    const i32 base = p.nodes_len();
     while (p.at().tag != TOKEN_EOF) {
         if (p.eat(TOKEN_FN)) {
             p.set_panic(false);
-            nodearr.push(parse_fn_decl(p, false));
+            p.push_node(parse_fn_decl(p, false));
         } else if (p.eat(TOKEN_CLASS)) {
             p.set_panic(false);
-            nodearr.push(parse_class_decl(p));
+            p.push_node(parse_class_decl(p));
         } else if (p.eat(TOKEN_IMPORT)) {
             p.set_panic(false);
-            nodearr.push(parse_import(p));
+            p.push_node(parse_import(p));
         } else {
             p.advance_with_err("expected declaration");
         }
     }
-    const i32 cnt = nodearr.len();
-    DeclNode *const *const decls = move_dynarr(p.arena(), move(nodearr));
+    const i32 cnt = p.nodes_len() - base;
+    DeclNode *const *const decls = p.pop_nodes<DeclNode>(base);
     const Span span = {.start = "module", .len = 7, .line = 1};
     return *alloc<ModuleNode>(p.arena(), span, decls, cnt);
 }
@@ -11,6 +11,11 @@ class Parser {
     Token at_;
     Token prev_;
     bool panic_;
+    // lists of nodes and spans are pushed here while they are parsed and then copied into an arena slice of the
+    // right size. nested lists push on top of the list they are part of. a list cannot grow in place in the arena,
+    // since the nodes of its items are pushed there between its items. the copy is about 5% of parse time
+    Dynarr<Node *> nodes_;
+    Dynarr<Span> spans_;
 
 public:
     Arena &arena() const;
@@ -24,6 +29,29 @@ public:
     bool expect(TokenTag tag, const char *msg);
     void advance_with_err(const char *msg);
     void recover_block();
+    i32 nodes_len() const;
+    void push_node(Node *node);
+    i32 spans_len() const;
+    void push_span(Span span);
+    Span span_at(const i32 idx) const;
+    // pops the spans pushed since spans_len() was base
+    void drop_spans(const i32 base);
+    // copies the spans pushed since spans_len() was base into the arena and pops them
+    Span *pop_spans(const i32 base);
+
+    // copies the nodes pushed since nodes_len() was base into the arena and pops them
+    template <typename T>
+    T **pop_nodes(const i32 base)
+    {
+        const i32 cnt = nodes_.len() - base;
+        T **nodes = reinterpret_cast<T **>(arena_.push(cnt * sizeof(T *), alignof(T *)));
+        for (i32 i = 0; i < cnt; i++)
+            nodes[i] = static_cast<T *>(nodes_[base + i]);
+        for (i32 i = 0; i < cnt; i++)
+            nodes_.pop();
+        return nodes;
+    }
+
     Parser(const char *source, Arena &arena, Dynarr<ErrMsg> &errarr)
         : arena_(arena), errarr(errarr), scanner(source, errarr)
     {
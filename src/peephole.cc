@@ -0,0 +1,195 @@
+#include "peephole.h"
+
+struct Instr {
+    i32 offset; // in the original code
+    i32 line;
+    u8 op;
+    i32 target;  // idx of the instr jumped to, -1 if not a jump
+    i32 pop_cnt; // values popped by OP_POP or OP_POP_N, including pops merged into it
+    bool live;
+    bool is_target;
+};
+
+static bool is_jump(const u8 op)
+{
+    return op == OP_JUMP || op == OP_JUMP_IF_FALSE || op == OP_JUMP_IF_TRUE;
+}
+
+static bool is_pop(const u8 op)
+{
+    return op == OP_POP || op == OP_POP_N;
+}
+
+static Dynarr<Instr> decode(const Dynarr<u8> &code, const Dynarr<i32> &lines)
+{
+    Dynarr<Instr> instrs;
+    // idx of the instr that starts at each offset, -1 for args
+    Dynarr<i32> instr_at;
+    i32 run = 0;
+    i32 run_left = lines[1];
+    for (i32 offset = 0; offset < code.len();) {
+        const i32 len = instr_len(code.raw() + offset);
+        const u8 op = code[offset];
+        const i32 pop_cnt = op == OP_POP ? 1 : op == OP_POP_N ? code[offset + 1] : 0;
+        instrs.push({offset, lines[run], op, -1, pop_cnt, false, false});
+        for (i32 i = 0; i < len; i++) {
+            instr_at.push(i == 0 ? instrs.len() - 1 : -1);
+            if (--run_left == 0 && run + 2 < lines.len()) {
+                run += 2;
+                run_left = lines[run + 1];
+            }
+        }
+        offset += len;
+    }
+    instr_at.push(instrs.len());
+    for (i32 i = 0; i < instrs.len(); i++) {
+        Instr &instr = instrs[i];
+        if (is_jump(instr.op)) {
+            const i32 jump = (code[instr.offset + 1] << 8) | code[instr.offset + 2];
+            instr.target = instr_at[instr.offset + 3 + jump];
+        }
+    }
+    return instrs;
+}
+
+// a jump that lands on another jump goes directly to where that jump ends up
+static void thread_jumps(Dynarr<Instr> &instrs, const i32 code_len)
+{
+    for (i32 i = 0; i < instrs.len(); i++) {
+        Instr &instr = instrs[i];
+        if (!is_jump(instr.op))
+            continue;
+        while (instr.target < instrs.len()) {
+            const Instr &tgt = instrs[instr.target];
+            i32 next;
+            if (tgt.op == OP_JUMP)
+                next = tgt.target;
+            else if (instr.op != OP_JUMP && tgt.op == instr.op)
+                // conditional jumps do not pop, so the second one sees the same value and is taken as well
+                next = tgt.target;
+            else if (instr.op != OP_JUMP && is_jump(tgt.op))
+                // ...or is not taken
+                next = instr.target + 1;
+            else
+                break;
+            // removing code only shortens jumps, so a target that is in range now stays in range
+            const i32 next_offset = next < instrs.len() ? instrs[next].offset : code_len;
+            if (next_offset - (instr.offset + 3) > 0xffff)
+                break;
+            instr.target = next;
+        }
+    }
+}
+
+static void mark_live(Dynarr<Instr> &instrs)
+{
+    Dynarr<i32> worklist;
+    worklist.push(0);
+    while (worklist.len() > 0) {
+        const i32 i = worklist[worklist.len() - 1];
+        worklist.pop();
+        if (i >= instrs.len() || instrs[i].live)
+            continue;
+        instrs[i].live = true;
+        if (is_jump(instrs[i].op))
+            worklist.push(instrs[i].target);
+        if (instrs[i].op != OP_JUMP && instrs[i].op != OP_RETURN)
+            worklist.push(i + 1);
+    }
+}
+
+static i32 next_live(const Dynarr<Instr> &instrs, i32 i)
+{
+    for (i++; i < instrs.len() && !instrs[i].live; i++)
+        ;
+    return i;
+}
+
+// idx of the instr at offset in the original code, instrs.len() for the end of the code
+static i32 instr_at_offset(const Dynarr<Instr> &instrs, const i32 offset)
+{
+    i32 lo = 0;
+    i32 hi = instrs.len();
+    while (lo < hi) {
+        const i32 mid = (lo + hi) / 2;
+        if (instrs[mid].offset < offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+void peephole(Chunk &chunk)
+{
+    const Dynarr<u8> code = chunk.code();
+    const Dynarr<i32> lines = chunk.lines();
+    Dynarr<Instr> instrs = decode(code, lines);
+    thread_jumps(instrs, code.len());
+    mark_live(instrs);
+
+    // an unconditional jump to the next instr does nothing
+    for (i32 i = 0; i < instrs.len(); i++) {
+        if (instrs[i].live && instrs[i].op == OP_JUMP && instrs[i].target == next_live(instrs, i))
+            instrs[i].live = false;
+    }
+    for (i32 i = 0; i < instrs.len(); i++) {
+        if (instrs[i].live && is_jump(instrs[i].op) && instrs[i].target < instrs.len())
+            instrs[instrs[i].target].is_target = true;
+    }
+    // merge runs of pops, unless a jump lands in the middle of the run
+    for (i32 i = 0; i < instrs.len(); i++) {
+        if (!instrs[i].live || !is_pop(instrs[i].op))
+            continue;
+        i32 j;
+        while ((j = next_live(instrs, i)) < instrs.len() && is_pop(instrs[j].op) && !instrs[j].is_target &&
+               instrs[i].pop_cnt + instrs[j].pop_cnt <= 255) {
+            instrs[i].pop_cnt += instrs[j].pop_cnt;
+            instrs[j].live = false;
+        }
+    }
+
+    // a removed instr takes the offset of the next live one, so jumps to it land there
+    Dynarr<i32> new_offsets;
+    i32 pos = 0;
+    for (i32 i = 0; i < instrs.len(); i++) {
+        new_offsets.push(pos);
+        if (!instrs[i].live)
+            continue;
+        if (is_pop(instrs[i].op))
+            pos += instrs[i].pop_cnt == 1 ? 1 : 2;
+        else
+            pos += instr_len(code.raw() + instrs[i].offset);
+    }
+    new_offsets.push(pos);
+    // inlined ranges start and end on instrs, and move with them
+    Dynarr<InlinedRange> &inlined = chunk.inlined();
+    for (i32 i = 0; i < inlined.len(); i++) {
+        inlined[i].start = new_offsets[instr_at_offset(instrs, inlined[i].start)];
+        inlined[i].end = new_offsets[instr_at_offset(instrs, inlined[i].end)];
+    }
+
+    chunk.clear_code();
+    for (i32 i = 0; i < instrs.len(); i++) {
+        const Instr &instr = instrs[i];
+        if (!instr.live)
+            continue;
+        if (is_pop(instr.op)) {
+            if (instr.pop_cnt == 1) {
+                chunk.emit_byte(OP_POP, instr.line);
+            } else {
+                chunk.emit_byte(OP_POP_N, instr.line);
+                chunk.emit_byte(instr.pop_cnt, instr.line);
+            }
+        } else if (is_jump(instr.op)) {
+            const i32 jump = new_offsets[instr.target] - (new_offsets[i] + 3);
+            chunk.emit_byte(instr.op, instr.line);
+            chunk.emit_byte((jump >> 8) & 0xff, instr.line);
+            chunk.emit_byte(jump & 0xff, instr.line);
+        } else {
+            const i32 len = instr_len(code.raw() + instr.offset);
+            for (i32 j = 0; j < len; j++)
+                chunk.emit_byte(code[instr.offset + j], instr.line);
+        }
+    }
+}
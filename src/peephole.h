@@ -0,0 +1,5 @@
+#pragma once
+#include "chunk.h"
+
+// rewrites the code of chunk in place: threads jumps, removes unreachable code and merges pops
+void peephole(Chunk &chunk);
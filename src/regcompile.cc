@@ -0,0 +1,525 @@
+#include "ast.h"
+#include "chunk.h"
+#include "compile.h"
+#include "gc.h"
+#include "object.h"
+#include "value.h"
+
+#define MAX_REGS   (256)
+#define LIST_CHUNK (64) // elements of a list literal that are in registers at once
+
+static u8 reg_binary_op(const TokenTag tag)
+{
+    // clang-format off
+    switch (tag) {
+    case TOKEN_PLUS:
+    case TOKEN_PLUS_EQ:        return REG_ADD;
+    case TOKEN_MINUS:
+    case TOKEN_MINUS_EQ:       return REG_SUB;
+    case TOKEN_STAR:
+    case TOKEN_STAR_EQ:        return REG_MUL;
+    case TOKEN_SLASH:
+    case TOKEN_SLASH_EQ:       return REG_DIV;
+    case TOKEN_SLASH_SLASH:
+    case TOKEN_SLASH_SLASH_EQ: return REG_FLOORDIV;
+    case TOKEN_PERCENT:
+    case TOKEN_PERCENT_EQ:     return REG_MOD;
+    case TOKEN_LT:             return REG_LT;
+    case TOKEN_LEQ:            return REG_LEQ;
+    case TOKEN_GT:             return REG_GT;
+    case TOKEN_GEQ:            return REG_GEQ;
+    case TOKEN_EQEQ:           return REG_EQEQ;
+    case TOKEN_NEQ:            return REG_NEQ;
+    default:                   return 0;
+    }
+    // clang-format on
+}
+
+// whether evaluating the expr may assign to a variable. if so, an operand that was evaluated before it and that
+// reads a local in place must be copied first, otherwise it would see the new value
+static bool has_assign(const Node &node)
+{
+    switch (node.tag) {
+    case NODE_ASSIGN: return true;
+    case NODE_LIST: {
+        const auto &list = static_cast<const ListNode &>(node);
+        for (i32 i = 0; i < list.cnt; i++) {
+            if (has_assign(*list.items[i]))
+                return true;
+        }
+        return false;
+    }
+    case NODE_UNARY: return has_assign(*static_cast<const UnaryNode &>(node).rhs);
+    case NODE_BINARY: {
+        const auto &binary = static_cast<const BinaryNode &>(node);
+        return has_assign(*binary.lhs) || has_assign(*binary.rhs);
+    }
+    case NODE_SUBSCR: {
+        const auto &subscr = static_cast<const SubscrNode &>(node);
+        return has_assign(*subscr.lhs) || has_assign(*subscr.rhs);
+    }
+    case NODE_SELECTOR: return has_assign(*static_cast<const SelectorNode &>(node).lhs);
+    case NODE_CALL: {
+        const auto &call = static_cast<const CallNode &>(node);
+        if (has_assign(*call.lhs))
+            return true;
+        for (i32 i = 0; i < call.arity; i++) {
+            if (has_assign(*call.args[i]))
+                return true;
+        }
+        return false;
+    }
+    default: return false;
+    }
+}
+
+// NOTE:
+// registers are slots relative to bp. params and locals keep the slots sema assigned them, temporaries are
+// allocated above the live locals in stack order and freed at the end of the expr that needed them.
+//      x = a + b * c;
+// compiles to
+//      REG_MUL  t0, b, c
+//      REG_ADD  x, a, t0
+// where the stack instruction set needs seven instructions
+struct RegCompiler final : AstVisitor {
+    FnObj *fn;
+    FnDeclNode *fn_node;
+    VM &vm;
+    Dynarr<ErrMsg> &errarr;
+    i32 dst;      // register the expr being visited writes its result to
+    i32 top;      // first free register
+    i32 n_locals; // registers below this hold variables
+    RegCompiler(VM &vm, Dynarr<ErrMsg> &errarr)
+        : fn(nullptr), fn_node(nullptr), vm(vm), errarr(errarr), dst(0), top(0), n_locals(0)
+    {
+    }
+
+    Chunk &chunk()
+    {
+        return fn->chunk;
+    }
+
+    void emit(const i32 line, const u8 op, const u8 a)
+    {
+        chunk().emit_byte(op, line);
+        chunk().emit_byte(a, line);
+    }
+
+    void emit(const i32 line, const u8 op, const u8 a, const u8 b)
+    {
+        emit(line, op, a);
+        chunk().emit_byte(b, line);
+    }
+
+    void emit(const i32 line, const u8 op, const u8 a, const u8 b, const u8 c)
+    {
+        emit(line, op, a, b);
+        chunk().emit_byte(c, line);
+    }
+
+    // make registers up to (excluding) n usable
+    void reserve(const Span span, const i32 n)
+    {
+        if (n > MAX_REGS) {
+            if (fn->reg_cnt <= MAX_REGS)
+                errarr.push({span, "too many registers"});
+            fn->reg_cnt = MAX_REGS + 1;
+        } else if (n > fn->reg_cnt) {
+            fn->reg_cnt = n;
+        }
+    }
+
+    i32 alloc_reg(const Span span)
+    {
+        reserve(span, top + 1);
+        // once there are too many registers the code is discarded, keep the operands in range
+        return top < MAX_REGS ? top++ : MAX_REGS - 1;
+    }
+
+    i32 emit_jump(const RegOpCode op, const i32 reg, const i32 line)
+    {
+        chunk().emit_byte(op, line);
+        if (op != REG_JUMP)
+            chunk().emit_byte(reg, line);
+        const i32 offset = chunk().code().len();
+        chunk().emit_byte(0, line);
+        chunk().emit_byte(0, line);
+        return offset;
+    }
+
+    void patch_jump(const Span span, const i32 offset)
+    {
+        // offset is idx of the hi byte of the jump
+        const i32 jump = chunk().code().len() - (offset + 2);
+        if (jump > ((1 << 16) - 1))
+            errarr.push({span, "jump too far"});
+        chunk().code()[offset] = (jump >> 8) & 0xff;
+        chunk().code()[offset + 1] = jump & 0xff;
+    }
+
+    void compile_to(Node &node, const i32 reg)
+    {
+        const i32 saved_dst = dst;
+        dst = reg;
+        visit_expr(node);
+        dst = saved_dst;
+    }
+
+    // returns a register holding the value of the expr. a local is read in place unless copy is set
+    i32 compile_any(Node &node, const bool copy)
+    {
+        if (!copy && node.tag == NODE_IDENT) {
+            const DeclNode &decl = *static_cast<IdentNode &>(node).decl;
+            if (decl.loc.tag == LOC_LOCAL)
+                return decl.loc.idx;
+        }
+        const i32 reg = alloc_reg(node.span);
+        compile_to(node, reg);
+        return reg;
+    }
+
+    void visit_atom(AtomNode &node) override
+    {
+        const i32 line = node.span.line;
+        // clang-format off
+        switch (node.atom_tag) {
+        case TOKEN_NULL:   emit(line, REG_LOADNULL, dst); break;
+        case TOKEN_TRUE:   emit(line, REG_LOADTRUE, dst); break;
+        case TOKEN_FALSE:  emit(line, REG_LOADFALSE, dst); break;
+        case TOKEN_NUMBER: emit(line, REG_LOADK, dst, chunk().add_constant(MK_NUM(node.num))); break;
+        case TOKEN_STRING:
+            emit(line, REG_LOADK, dst, chunk().add_constant(MK_OBJ(alloc<StringObj>(vm, node.span))));
+            break;
+        default: break; // the parser only makes atoms of the tokens above
+        }
+        // clang-format on
+    }
+
+    void visit_ident(IdentNode &node) override
+    {
+        const i32 line = node.span.line;
+        const Loc loc = node.decl->loc;
+        // clang-format off
+        switch (loc.tag) {
+        case LOC_LOCAL:            if (loc.idx != dst) emit(line, REG_MOVE, dst, loc.idx); break;
+        case LOC_GLOBAL:           emit(line, REG_GET_GLOBAL, dst, loc.idx); break;
+        case LOC_STACK_HEAPVAL:    emit(line, REG_GET_HEAPVAL, dst, loc.idx); break;
+        case LOC_CAPTURED_HEAPVAL: emit(line, REG_GET_CAPTURED, dst, loc.idx); break;
+        }
+        // clang-format on
+    }
+
+    void emit_ident_set(IdentNode &node, const i32 src)
+    {
+        const i32 line = node.span.line;
+        const Loc loc = node.decl->loc;
+        // clang-format off
+        switch (loc.tag) {
+        case LOC_LOCAL:            if (loc.idx != src) emit(line, REG_MOVE, loc.idx, src); break;
+        case LOC_GLOBAL:           emit(line, REG_SET_GLOBAL, loc.idx, src); break;
+        case LOC_STACK_HEAPVAL:    emit(line, REG_SET_HEAPVAL, loc.idx, src); break;
+        case LOC_CAPTURED_HEAPVAL: emit(line, REG_SET_CAPTURED, loc.idx, src); break;
+        }
+        // clang-format on
+    }
+
+    void visit_list(ListNode &node) override
+    {
+        if (ListObj *tmpl = const_list(vm, node)) {
+            emit(node.span.line, REG_LIST_CONST, dst, chunk().add_constant(MK_OBJ(tmpl)));
+            return;
+        }
+        const i32 saved_top = top;
+        // a longer list is made of its first LIST_CHUNK elements and the rest are appended LIST_CHUNK at a time,
+        // reusing the same registers. it is moved to dst once it is complete, since its elements may read dst
+        const i32 list = node.cnt > LIST_CHUNK ? alloc_reg(node.span) : dst;
+        const i32 base = top;
+        for (i32 start = 0; start == 0 || start < node.cnt; start += LIST_CHUNK) {
+            const i32 cnt = node.cnt - start < LIST_CHUNK ? node.cnt - start : LIST_CHUNK;
+            top = base;
+            for (i32 i = start; i < start + cnt; i++)
+                compile_to(*node.items[i], alloc_reg(node.items[i]->span));
+            emit(node.span.line, start == 0 ? REG_LIST : REG_LIST_APPEND, list, base, cnt);
+        }
+        if (list != dst)
+            emit(node.span.line, REG_MOVE, dst, list);
+        top = saved_top;
+    }
+
+    void visit_unary(UnaryNode &node) override
+    {
+        const i32 saved_top = top;
+        const i32 rhs = compile_any(*node.rhs, false);
+        emit(node.span.line, node.op_tag == TOKEN_MINUS ? REG_NEGATE : REG_NOT, dst, rhs);
+        top = saved_top;
+    }
+
+    void visit_binary(BinaryNode &node) override
+    {
+        const i32 line = node.span.line;
+        const i32 saved_top = top;
+        const TokenTag op_tag = node.op_tag;
+        if (op_tag == TOKEN_AND || op_tag == TOKEN_OR) {
+            // the lhs is written to dst before the rhs is evaluated, which must not clobber a variable the rhs reads
+            const i32 reg = dst < n_locals ? alloc_reg(node.span) : dst;
+            compile_to(*node.lhs, reg);
+            const i32 offset = emit_jump(op_tag == TOKEN_AND ? REG_JUMP_IF_FALSE : REG_JUMP_IF_TRUE, reg, line);
+            compile_to(*node.rhs, reg);
+            patch_jump(node.span, offset);
+            if (reg != dst)
+                emit(line, REG_MOVE, dst, reg);
+            top = saved_top;
+            return;
+        }
+        const i32 lhs = compile_any(*node.lhs, has_assign(*node.rhs));
+        const i32 rhs = compile_any(*node.rhs, false);
+        emit(line, reg_binary_op(op_tag), dst, lhs, rhs);
+        top = saved_top;
+    }
+
+    void visit_subscr(SubscrNode &node) override
+    {
+        const i32 saved_top = top;
+        const i32 lhs = compile_any(*node.lhs, has_assign(*node.rhs));
+        const i32 rhs = compile_any(*node.rhs, false);
+        emit(node.span.line, REG_GET_SUBSCR, dst, lhs, rhs);
+        top = saved_top;
+    }
+
+    void visit_selector(SelectorNode &node) override
+    {
+        const i32 saved_top = top;
+        const i32 lhs = compile_any(*node.lhs, false);
+        const u8 idx = chunk().add_constant(MK_OBJ(alloc<StringObj>(vm, String(node.sym))));
+        emit(node.span.line, node.op_tag == TOKEN_DOT ? REG_GET_FIELD : REG_GET_METHOD, dst, lhs, idx);
+        top = saved_top;
+    }
+
+    // the operands are evaluated in the same order as with the stack instruction set: the rhs first, then the
+    // target. a compound assignment also reads the target before the rhs. result is -1 if the value is unused
+    void compile_assign(AssignNode &node, const i32 result)
+    {
+        const i32 line = node.span.line;
+        const i32 saved_top = top;
+        const bool compound = node.op_tag != TOKEN_EQ;
+        const u8 op = reg_binary_op(node.op_tag);
+        i32 val;
+        if (node.lhs->tag == NODE_IDENT) {
+            IdentNode &ident = static_cast<IdentNode &>(*node.lhs);
+            const Loc loc = ident.decl->loc;
+            if (compound) {
+                const i32 cur = compile_any(ident, has_assign(*node.rhs));
+                const i32 rhs = compile_any(*node.rhs, false);
+                val = loc.tag == LOC_LOCAL ? loc.idx : cur;
+                emit(line, op, val, cur, rhs);
+            } else if (loc.tag == LOC_LOCAL) {
+                val = loc.idx;
+                compile_to(*node.rhs, val);
+            } else {
+                val = compile_any(*node.rhs, false);
+            }
+            emit_ident_set(ident, val);
+        } else if (node.lhs->tag == NODE_SUBSCR) {
+            SubscrNode &lhs = static_cast<SubscrNode &>(*node.lhs);
+            if (compound) {
+                val = alloc_reg(node.span);
+                compile_to(lhs, val);
+                const i32 rhs = compile_any(*node.rhs, false);
+                emit(line, op, val, val, rhs);
+            } else {
+                val = compile_any(*node.rhs, has_assign(lhs));
+            }
+            const i32 container = compile_any(*lhs.lhs, has_assign(*lhs.rhs));
+            const i32 idx = compile_any(*lhs.rhs, false);
+            emit(line, REG_SET_SUBSCR, container, idx, val);
+        } else {
+            SelectorNode &lhs = static_cast<SelectorNode &>(*node.lhs);
+            if (compound) {
+                val = alloc_reg(node.span);
+                compile_to(lhs, val);
+                const i32 rhs = compile_any(*node.rhs, false);
+                emit(line, op, val, val, rhs);
+            } else {
+                val = compile_any(*node.rhs, has_assign(*lhs.lhs));
+            }
+            const i32 obj = compile_any(*lhs.lhs, false);
+            const u8 idx = chunk().add_constant(MK_OBJ(alloc<StringObj>(vm, lhs.sym)));
+            emit(line, REG_SET_FIELD, obj, idx, val);
+        }
+        if (result != -1 && result != val)
+            emit(line, REG_MOVE, result, val);
+        top = saved_top;
+    }
+
+    void visit_assign(AssignNode &node) override
+    {
+        compile_assign(node, dst);
+    }
+
+    void visit_call(CallNode &node) override
+    {
+        const i32 line = node.span.line;
+        const i32 saved_top = top;
+        // the callee and args are evaluated into consecutive registers, the callee's frame starts at the first arg.
+        // a temporary on top of the stack of registers is free to hold the callee itself
+        const i32 base = dst >= n_locals && dst == top - 1 ? dst : alloc_reg(node.span);
+        compile_to(*node.lhs, base);
+        for (i32 i = 0; i < node.arity; i++)
+            compile_to(*node.args[i], alloc_reg(node.args[i]->span));
+        // a method or an init gets self as an extra arg
+        reserve(node.span, top + 1);
+        emit(line, REG_CALL, base, node.arity);
+        if (dst != base)
+            emit(line, REG_MOVE, dst, base);
+        top = saved_top;
+    }
+
+    void visit_if(IfNode &node) override
+    {
+        const i32 line = node.span.line;
+        const i32 saved_top = top;
+        //      REG_JUMP_IF_FALSE cond (jump 1)
+        //      thn block
+        //      REG_JUMP               (jump 2)
+        //      els block              (destination of jump 1)
+        //      ...                    (destination of jump 2)
+        const i32 cond = compile_any(*node.cond, false);
+        top = saved_top;
+        const i32 offset1 = emit_jump(REG_JUMP_IF_FALSE, cond, line);
+        visit_block(*node.thn);
+        if (node.els) {
+            const i32 offset2 = emit_jump(REG_JUMP, 0, line);
+            patch_jump(node.span, offset1);
+            visit_block(*node.els);
+            patch_jump(node.span, offset2);
+        } else {
+            patch_jump(node.span, offset1);
+        }
+    }
+
+    void visit_expr_stmt(ExprStmtNode &node) override
+    {
+        const i32 saved_top = top;
+        if (node.expr->tag == NODE_ASSIGN)
+            compile_assign(static_cast<AssignNode &>(*node.expr), -1);
+        else
+            compile_any(*node.expr, false);
+        top = saved_top;
+    }
+
+    void emit_implicit_return(const i32 line)
+    {
+        if (fn_node->flags & FLAG_INIT) {
+            emit(line, REG_RETURN, fn_node->arity - 1);
+        } else {
+            const i32 saved_top = top;
+            const i32 reg = alloc_reg(fn_node->span);
+            emit(line, REG_LOADNULL, reg);
+            emit(line, REG_RETURN, reg);
+            top = saved_top;
+        }
+    }
+
+    void visit_return(ReturnNode &node) override
+    {
+        if (!node.expr) {
+            emit_implicit_return(node.span.line);
+            return;
+        }
+        const i32 saved_top = top;
+        emit(node.span.line, REG_RETURN, compile_any(*node.expr, false));
+        top = saved_top;
+    }
+
+    void visit_print(PrintNode &node) override
+    {
+        const i32 saved_top = top;
+        emit(node.span.line, REG_PRINT, compile_any(*node.expr, false));
+        top = saved_top;
+    }
+
+    // the variable's register is reserved before its initializer is compiled into it, but it only counts as a
+    // live local afterwards since the initializer cannot refer to it
+    void begin_decl(DeclNode &node)
+    {
+        top = node.loc.idx + 1;
+        reserve(node.span, top);
+    }
+
+    void end_decl(DeclNode &node)
+    {
+        // move variable on heap if it is captured
+        if (node.flags & FLAG_CAPTURED)
+            emit(node.span.line, REG_HEAPVAL, node.loc.idx);
+        n_locals = node.loc.idx + 1;
+    }
+
+    void visit_var_decl(VarDeclNode &node) override
+    {
+        begin_decl(node);
+        if (node.init)
+            compile_to(*node.init, node.loc.idx);
+        else
+            emit(node.span.line, REG_LOADNULL, node.loc.idx);
+        end_decl(node);
+    }
+
+    FnObj *compile_fn_body(FnDeclNode &node)
+    {
+        FnObj *parent = this->fn;
+        FnDeclNode *parent_node = this->fn_node;
+        const i32 parent_top = top;
+        const i32 parent_n_locals = n_locals;
+        this->fn = alloc<FnObj>(vm, alloc<StringObj>(vm, node.span), Chunk(), node.arity);
+        this->fn_node = &node;
+        fn->reg_cnt = node.arity;
+        top = node.arity;
+        n_locals = node.arity;
+
+        const i32 line = node.span.line;
+        for (i32 i = 0; i < node.arity; i++) {
+            // move param on heap if it is captured
+            if (node.params[i].flags & FLAG_CAPTURED)
+                emit(line, REG_HEAPVAL, node.params[i].loc.idx);
+        }
+        visit_block(*node.body);
+        emit_implicit_return(line);
+        FnObj *result = this->fn;
+        this->fn = parent;
+        this->fn_node = parent_node;
+        top = parent_top;
+        n_locals = parent_n_locals;
+        return result;
+    }
+
+    void visit_fn_decl(FnDeclNode &node) override
+    {
+        const i32 line = node.span.line;
+        begin_decl(node);
+        const u8 idx = chunk().add_constant(MK_OBJ(compile_fn_body(node)));
+        // wrap the fn in a closure
+        emit(line, REG_CLOSURE, node.loc.idx, idx, node.capture_cnt);
+        for (i32 i = 0; i < node.capture_cnt; i++) {
+            chunk().emit_byte(node.captures[i]->decl_original->loc.tag, line);
+            chunk().emit_byte(node.captures[i]->decl_original->loc.idx, line);
+        }
+        end_decl(node);
+    }
+
+    void visit_block(BlockNode &node) override
+    {
+        // the locals of the block are dead after it, there is nothing to pop
+        const i32 saved_top = top;
+        const i32 saved_n_locals = n_locals;
+        for (i32 i = 0; i < node.cnt; i++)
+            visit_stmt(*node.stmts[i]);
+        top = saved_top;
+        n_locals = saved_n_locals;
+    }
+};
+
+ClosureObj *compile_reg(VM &vm, ModuleNode &node, Dynarr<ErrMsg> &errarr)
+{
+    RegCompiler compiler(vm, errarr);
+    return compile_module(vm, node, compiler);
+}
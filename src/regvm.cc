@@ -0,0 +1,359 @@
+#include "ast.h"
+#include "gc.h"
+#include "object.h"
+#include "value.h"
+#include "vm.h"
+#include <math.h>
+#include <stdio.h>
+
+// NOTE:
+// every instruction reads all of its operands before it executes, so when it fails ip - 1 still points into it
+// and runtime_err reports its line
+
+#define NUM_BINARY_OP(make, expr)                                                                                      \
+    do {                                                                                                               \
+        const u8 a = ip[0], b = ip[1], c = ip[2];                                                                      \
+        ip += 3;                                                                                                       \
+        const Value lhs = bp[b];                                                                                       \
+        const Value rhs = bp[c];                                                                                       \
+        if (!IS_NUM(lhs) || !IS_NUM(rhs))                                                                              \
+            return runtime_err(ip, vm, "operands must be numbers");                                                    \
+        const double x = AS_NUM(lhs);                                                                                  \
+        const double y = AS_NUM(rhs);                                                                                  \
+        bp[a] = make(expr);                                                                                            \
+    } while (0)
+
+// values above the params may be left over from a previous frame whose objects have since been collected
+static void clear_regs(Value *bp, const i32 from, const i32 to)
+{
+    for (i32 i = from; i < to; i++)
+        bp[i] = MK_NULL;
+}
+
+InterpResult run_reg_vm(VM &vm, ClosureObj &script)
+{
+    ClosureObj *cur_closure = &script;
+
+    vm.val_stack[0] = MK_OBJ(cur_closure);
+    Value *bp = vm.val_stack + 1;
+    clear_regs(bp, 0, cur_closure->fn->reg_cnt);
+
+    CallFrame *frame = vm.call_stack;
+    frame->closure = cur_closure;
+    frame->bp = bp;
+    vm.call_cnt = 1;
+    cur_closure->fn->call_cnt++;
+
+    const u8 *ip = cur_closure->fn->chunk.instrs();
+
+    while (true) {
+        const u8 op = *ip;
+        ip++;
+        switch (op) {
+        case REG_LOADNULL: {
+            bp[ip[0]] = MK_NULL;
+            ip++;
+            break;
+        }
+        case REG_LOADTRUE: {
+            bp[ip[0]] = MK_BOOL(true);
+            ip++;
+            break;
+        }
+        case REG_LOADFALSE: {
+            bp[ip[0]] = MK_BOOL(false);
+            ip++;
+            break;
+        }
+        case REG_LOADK: {
+            bp[ip[0]] = cur_closure->fn->chunk.constants()[ip[1]];
+            ip += 2;
+            break;
+        }
+        case REG_MOVE: {
+            bp[ip[0]] = bp[ip[1]];
+            ip += 2;
+            break;
+        }
+        case REG_ADD: {
+            const u8 a = ip[0], b = ip[1], c = ip[2];
+            ip += 3;
+            const Value lhs = bp[b];
+            const Value rhs = bp[c];
+            if (IS_NUM(lhs) && IS_NUM(rhs))
+                bp[a] = MK_NUM(AS_NUM(lhs) + AS_NUM(rhs));
+            else if (IS_STRING(lhs) && IS_STRING(rhs))
+                bp[a] = MK_OBJ(concat_strings(vm, AS_STRING(lhs), AS_STRING(rhs)));
+            else
+                return runtime_err(ip, vm, "operands must be numbers or strings");
+            break;
+        }
+        // clang-format off
+        case REG_SUB:      NUM_BINARY_OP(MK_NUM, x - y); break;
+        case REG_MUL:      NUM_BINARY_OP(MK_NUM, x * y); break;
+        case REG_DIV:      NUM_BINARY_OP(MK_NUM, x / y); break;
+        case REG_FLOORDIV: NUM_BINARY_OP(MK_NUM, floor(x / y)); break;
+        case REG_MOD:      NUM_BINARY_OP(MK_NUM, fmod(x, y)); break;
+        case REG_LT:       NUM_BINARY_OP(MK_BOOL, x < y); break;
+        case REG_LEQ:      NUM_BINARY_OP(MK_BOOL, x <= y); break;
+        case REG_GT:       NUM_BINARY_OP(MK_BOOL, x > y); break;
+        case REG_GEQ:      NUM_BINARY_OP(MK_BOOL, x >= y); break;
+        // clang-format on
+        case REG_EQEQ: {
+            bp[ip[0]] = MK_BOOL(val_eq(bp[ip[1]], bp[ip[2]]));
+            ip += 3;
+            break;
+        }
+        case REG_NEQ: {
+            bp[ip[0]] = MK_BOOL(!val_eq(bp[ip[1]], bp[ip[2]]));
+            ip += 3;
+            break;
+        }
+        case REG_NEGATE: {
+            const u8 a = ip[0], b = ip[1];
+            ip += 2;
+            if (!IS_NUM(bp[b]))
+                return runtime_err(ip, vm, "operand must be number");
+            bp[a] = MK_NUM(-AS_NUM(bp[b]));
+            break;
+        }
+        case REG_NOT: {
+            const u8 a = ip[0], b = ip[1];
+            ip += 2;
+            if (!IS_BOOL(bp[b]))
+                return runtime_err(ip, vm, "operand must be boolean");
+            bp[a] = MK_BOOL(!AS_BOOL(bp[b]));
+            break;
+        }
+        case REG_LIST: {
+            const u8 a = ip[0], b = ip[1], cnt = ip[2];
+            ip += 3;
+            bp[a] = MK_OBJ(alloc<ListObj>(vm, bp + b, cnt));
+            break;
+        }
+        case REG_LIST_APPEND: {
+            const u8 a = ip[0], b = ip[1], cnt = ip[2];
+            ip += 3;
+            ListObj *list = AS_LIST(bp[a]);
+            for (i32 i = 0; i < cnt; i++)
+                list->push(bp[b + i]);
+            break;
+        }
+        case REG_LIST_CONST: {
+            const u8 a = ip[0], idx = ip[1];
+            ip += 2;
+            bp[a] = MK_OBJ(alloc<ListObj>(vm, AS_LIST(cur_closure->fn->chunk.constants()[idx])));
+            break;
+        }
+        case REG_HEAPVAL: {
+            const u8 a = *ip++;
+            bp[a] = MK_OBJ(alloc<HeapValObj>(vm, bp[a]));
+            break;
+        }
+        case REG_CLOSURE: {
+            const u8 a = ip[0], idx = ip[1], captures = ip[2];
+            ip += 3;
+            ClosureObj *closure = alloc<ClosureObj>(vm, AS_FN(cur_closure->fn->chunk.constants()[idx]), captures);
+            bp[a] = MK_OBJ(closure);
+            for (i32 i = 0; i < captures; i++) {
+                const LocTag tag = LocTag(*ip++);
+                const i32 loc_idx = *ip++;
+                if (tag == LOC_CAPTURED_HEAPVAL) {
+                    closure->captures[i] = cur_closure->captures[loc_idx];
+                } else if (loc_idx != a) {
+                    closure->captures[i] = AS_HEAP_VAL(bp[loc_idx]);
+                } else {
+                    // the closure captures itself, see OP_CLOSURE
+                    closure->captures[i] = alloc<HeapValObj>(vm, bp[loc_idx]);
+                }
+            }
+            break;
+        }
+        case REG_GET_HEAPVAL: {
+            bp[ip[0]] = AS_HEAP_VAL(bp[ip[1]])->val;
+            ip += 2;
+            break;
+        }
+        case REG_SET_HEAPVAL: {
+            AS_HEAP_VAL(bp[ip[0]])->val = bp[ip[1]];
+            ip += 2;
+            break;
+        }
+        case REG_GET_CAPTURED: {
+            bp[ip[0]] = cur_closure->captures[ip[1]]->val;
+            ip += 2;
+            break;
+        }
+        case REG_SET_CAPTURED: {
+            cur_closure->captures[ip[0]]->val = bp[ip[1]];
+            ip += 2;
+            break;
+        }
+        case REG_GET_GLOBAL: {
+            bp[ip[0]] = vm.globals[ip[1]];
+            ip += 2;
+            break;
+        }
+        case REG_SET_GLOBAL: {
+            vm.globals[ip[0]] = bp[ip[1]];
+            ip += 2;
+            break;
+        }
+        case REG_GET_SUBSCR: {
+            const u8 a = ip[0], b = ip[1], c = ip[2];
+            ip += 3;
+            if (!get_subscr(vm, ip, bp[b], bp[c], bp[a]))
+                return {.tag = INTERP_ERR, .message = ""};
+            break;
+        }
+        case REG_SET_SUBSCR: {
+            const u8 a = ip[0], b = ip[1], c = ip[2];
+            ip += 3;
+            if (!set_subscr(vm, ip, bp[a], bp[b], bp[c]))
+                return {.tag = INTERP_ERR, .message = ""};
+            break;
+        }
+        case REG_GET_FIELD: {
+            const u8 a = ip[0], b = ip[1], idx = ip[2];
+            ip += 3;
+            StringObj *prop = AS_STRING(cur_closure->fn->chunk.constants()[idx]);
+            if (!get_field(vm, ip, bp[b], prop, bp[a]))
+                return {.tag = INTERP_ERR, .message = ""};
+            break;
+        }
+        case REG_SET_FIELD: {
+            const u8 a = ip[0], idx = ip[1], c = ip[2];
+            ip += 3;
+            StringObj *prop = AS_STRING(cur_closure->fn->chunk.constants()[idx]);
+            if (!set_field(vm, ip, bp[a], prop, bp[c]))
+                return {.tag = INTERP_ERR, .message = ""};
+            break;
+        }
+        case REG_GET_METHOD: {
+            const u8 a = ip[0], b = ip[1], idx = ip[2];
+            ip += 3;
+            StringObj *prop = AS_STRING(cur_closure->fn->chunk.constants()[idx]);
+            if (!get_method(vm, ip, bp[b], prop, bp[a]))
+                return {.tag = INTERP_ERR, .message = ""};
+            break;
+        }
+        case REG_JUMP: {
+            const u16 offset = (ip += 2, (ip[-2] << 8) | ip[-1]);
+            ip += offset;
+            cur_closure->fn->count_jump(ip);
+            break;
+        }
+        case REG_JUMP_IF_FALSE: {
+            const Value val = bp[ip[0]];
+            const u16 offset = (ip += 3, (ip[-2] << 8) | ip[-1]);
+            if (!IS_BOOL(val))
+                return runtime_err(ip, vm, "operand must be boolean");
+            if (!AS_BOOL(val)) {
+                ip += offset;
+                cur_closure->fn->count_jump(ip);
+            }
+            break;
+        }
+        case REG_JUMP_IF_TRUE: {
+            const Value val = bp[ip[0]];
+            const u16 offset = (ip += 3, (ip[-2] << 8) | ip[-1]);
+            if (!IS_BOOL(val))
+                return runtime_err(ip, vm, "operand must be boolean");
+            if (AS_BOOL(val)) {
+                ip += offset;
+                cur_closure->fn->count_jump(ip);
+            }
+            break;
+        }
+        case REG_CALL: {
+            const u8 a = ip[0];
+            i32 param_cnt = ip[1];
+            ip += 2;
+            Value *args = bp + a + 1;
+            const Value val = bp[a];
+            ClosureObj *closure;
+            if (IS_CLOSURE(val)) {
+                closure = AS_CLOSURE(val);
+            } else if (IS_CLASS(val)) {
+                InstanceObj *instance = alloc<InstanceObj>(vm, AS_CLASS(val));
+                closure = AS_CLOSURE(*instance->klass->methods.find(*alloc<StringObj>(vm, "init")));
+                args[param_cnt] = MK_OBJ(instance);
+                param_cnt++;
+            } else if (IS_METHOD(val)) {
+                MethodObj *method = AS_METHOD(val);
+                closure = method->closure;
+                args[param_cnt] = MK_OBJ(method->self);
+                param_cnt++;
+            } else if (IS_FOREIGN_METHOD(val)) {
+                ForeignMethodObj *f_method = AS_FOREIGN_METHOD(val);
+                param_cnt++;
+                if (param_cnt != f_method->fn->arity)
+                    return runtime_err(ip, vm, "incorrect number of arguments provided");
+                args[param_cnt - 1] = MK_OBJ(f_method->self);
+                frame->ip = ip;
+                InterpResult res = f_method->fn->wrap(vm, args);
+                if (res.tag == INTERP_ERR)
+                    return runtime_err(ip, vm, res.message);
+                bp[a] = res.val;
+                break;
+            } else if (IS_FOREIGN_FN(val)) {
+                ForeignFnObj *f_fn = AS_FOREIGN_FN(val);
+                if (param_cnt != f_fn->arity)
+                    return runtime_err(ip, vm, "incorrect number of arguments provided");
+                frame->ip = ip;
+                InterpResult res = f_fn->wrap(vm, args);
+                if (res.tag == INTERP_ERR)
+                    return runtime_err(ip, vm, res.message);
+                bp[a] = res.val;
+                break;
+            } else {
+                return runtime_err(ip, vm, "attempt to call non-callable");
+            }
+            if (closure->fn->arity != param_cnt)
+                return runtime_err(ip, vm, "incorrect number of arguments provided");
+            if (vm.call_cnt + 1 >= MAX_CALL_FRAMES || args + closure->fn->reg_cnt > vm.val_stack + MAX_STACK)
+                return runtime_err(ip, vm, "stack overflow");
+            frame->ip = ip;
+            frame->bp = bp;
+            frame++;
+
+            cur_closure = closure;
+            frame->closure = cur_closure;
+            bp = args;
+            clear_regs(bp, param_cnt, cur_closure->fn->reg_cnt);
+            ip = cur_closure->fn->chunk.instrs();
+            vm.call_cnt++;
+            cur_closure->fn->call_cnt++;
+            break;
+        }
+        case REG_RETURN: {
+            const Value val = bp[ip[0]];
+            vm.call_cnt--;
+            if (vm.call_cnt == 0)
+                return {.tag = INTERP_OK, .val = val};
+            bp[-1] = val;
+            Value *const callee_end = bp + cur_closure->fn->reg_cnt;
+
+            frame--;
+            ip = frame->ip;
+            bp = frame->bp;
+            cur_closure = frame->closure;
+            // the caller's registers past the callee's were not roots while it ran, so they may hold collected objects
+            Value *const caller_end = bp + cur_closure->fn->reg_cnt;
+            if (callee_end < caller_end)
+                clear_regs(callee_end, 0, caller_end - callee_end);
+            break;
+        }
+        case REG_PRINT: {
+            print_val(bp[ip[0]]);
+            printf("\n");
+            ip++;
+            break;
+        }
+        }
+        // everything above the current frame's registers is dead
+        vm.sp = bp + cur_closure->fn->reg_cnt;
+        collect_garbage(vm);
+        collect_garbage(vm);
+    }
+}
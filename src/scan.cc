@@ -2,6 +2,12 @@
 #include "error.h"
 #include <string.h>
 
+// sse2 is part of x86-64, so it needs no check of the cpu
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define SCAN_SSE2
+#endif
+
 bool Span::operator==(Span other) const
 {
     return len == other.len && memcmp(start, other.start, len) == 0;
@@ -31,6 +37,103 @@ static bool is_alpha_digit(const char c)
     return is_digit(c) || is_alpha(c);
 }
 
+// the skip_ fns return the first byte from p on that is not in their class. most runs are short, so the first
+// SCALAR_PREFIX bytes are looked at one at a time, then 16 at a time. the null byte that ends the source is in no
+// class, so they do not check for the end, see SCAN_PADDING
+#define SCALAR_PREFIX (16)
+
+#ifdef SCAN_SSE2
+static __m128i load16(const char *p)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+}
+
+// bit i is set if byte i of v is in the range lo..=hi, which must be ascii
+static u32 in_range(const __m128i v, const char lo, const char hi)
+{
+    const __m128i ge = _mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1));
+    const __m128i le = _mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1));
+    return _mm_movemask_epi8(_mm_and_si128(ge, le));
+}
+
+static u32 is_byte(const __m128i v, const char c)
+{
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+}
+#endif
+
+// spaces, tabs and newlines, the newlines are counted in line
+static const char *skip_blank(const char *p, i32 &line)
+{
+    for (const char *stop = p + SCALAR_PREFIX; p < stop; p++) {
+        if (*p == '\n')
+            line++;
+        else if (*p != ' ' && *p != '\t')
+            return p;
+    }
+#ifdef SCAN_SSE2
+    for (;; p += 16) {
+        const __m128i v = load16(p);
+        const u32 newlines = is_byte(v, '\n');
+        const u32 blank = newlines | is_byte(v, ' ') | is_byte(v, '\t');
+        if (blank != 0xffff) {
+            const i32 n = __builtin_ctz(~blank);
+            line += __builtin_popcount(newlines & ((1u << n) - 1));
+            return p + n;
+        }
+        line += __builtin_popcount(newlines);
+    }
+#else
+    for (;; p++) {
+        if (*p == '\n')
+            line++;
+        else if (*p != ' ' && *p != '\t')
+            return p;
+    }
+#endif
+}
+
+static const char *skip_digits(const char *p)
+{
+    for (const char *stop = p + SCALAR_PREFIX; p < stop; p++) {
+        if (!is_digit(*p))
+            return p;
+    }
+#ifdef SCAN_SSE2
+    for (;; p += 16) {
+        const u32 digits = in_range(load16(p), '0', '9');
+        if (digits != 0xffff)
+            return p + __builtin_ctz(~digits);
+    }
+#else
+    while (is_digit(*p))
+        p++;
+    return p;
+#endif
+}
+
+static const char *skip_alpha_digits(const char *p)
+{
+    for (const char *stop = p + SCALAR_PREFIX; p < stop; p++) {
+        if (!is_alpha_digit(*p))
+            return p;
+    }
+#ifdef SCAN_SSE2
+    for (;; p += 16) {
+        const __m128i v = load16(p);
+        // setting bit 5 maps 'A'..='Z' onto 'a'..='z', and no byte outside them onto it
+        const u32 alpha = in_range(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z') | is_byte(v, '_');
+        const u32 alpha_digits = alpha | in_range(v, '0', '9');
+        if (alpha_digits != 0xffff)
+            return p + __builtin_ctz(~alpha_digits);
+    }
+#else
+    while (is_alpha_digit(*p))
+        p++;
+    return p;
+#endif
+}
+
 char Scanner::at() const
 {
     return current[0];
@@ -56,20 +159,12 @@ char Scanner::bump()
 
 void Scanner::skip_whitespace()
 {
-    while (true) {
-        switch (at()) {
-        case '\n': line++;
-        case ' ':
-        case '\t': bump(); break;
-        default: return;
-        }
-    }
+    current = skip_blank(current, line);
 }
 
 void Scanner::skip_comment()
 {
-    while (at() != '\n' && !is_at_end())
-        bump();
+    current = strchrnul(current, '\n');
     if (at() == '\n') {
         bump();
         line++;
@@ -87,29 +182,24 @@ Token Scanner::mk_token(TokenTag tag) const
 
 Token Scanner::number()
 {
-    while (is_digit(at()))
-        bump();
+    current = skip_digits(current);
 
     if (at() == '.' && is_digit(next())) {
         bump();
-        while (is_digit(at()))
-            bump();
+        current = skip_digits(current);
     }
     return mk_token(TOKEN_NUMBER);
 }
 
 Token Scanner::string()
 {
-    while (at() != '"') {
-        bump();
-        // TODO remove outdated TODO's >:)
-        // TODO support multi-line strings zig style
-        // TODO not increasing line if string contains newline, this is bad
-        if (is_at_end()) {
-            Token token = mk_token(TOKEN_ERR);
-            errarr.push({.span = token.span, .msg = "unterminated string"});
-            return token;
-        }
+    // TODO support multi-line strings zig style
+    // TODO not increasing line if string contains newline, this is bad
+    current = strchrnul(current, '"');
+    if (is_at_end()) {
+        Token token = mk_token(TOKEN_ERR);
+        errarr.push({.span = token.span, .msg = "unterminated string"});
+        return token;
     }
     bump();
     const Token token = {
@@ -130,8 +220,7 @@ Token Scanner::check_at(const char c, const TokenTag tagthen, const TokenTag tag
 
 Token Scanner::check_keyword(const char *rest, const i32 len, const TokenTag tag)
 {
-    while (is_alpha_digit(at()))
-        bump();
+    current = skip_alpha_digits(current);
     const i32 token_len = current - start;
     if (token_len != len || memcmp(start + 1, rest, len - 1) != 0)
         return mk_token(TOKEN_IDENTIFIER);
@@ -209,8 +298,7 @@ Token Scanner::next_token()
             case 't': return check_keyword("rue", 4, TOKEN_TRUE);
             case 'v': return check_keyword("ar", 3, TOKEN_VAR);
             default: {
-                while (is_alpha_digit(at()))
-                    bump();
+                current = skip_alpha_digits(current);
                 return mk_token(TOKEN_IDENTIFIER);
             }
             }
@@ -3,7 +3,11 @@
 
 struct ErrMsg;
 
-enum TokenTag {
+// the scanner reads up to SCAN_PADDING bytes past the null byte that ends the source, 16 at a time, so a buffer that
+// holds source must have that many bytes after it
+#define SCAN_PADDING (16)
+
+enum TokenTag : u8 {
     TOKEN_PLUS,
     TOKEN_MINUS,
     TOKEN_STAR,
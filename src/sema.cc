@@ -2,10 +2,21 @@
 #include "../libflood/arena.h"
 #include "../libflood/dynarr.h"
 #include "ast.h"
+#include "object.h"
+
+// an ident in a nested fn resolves to a CaptureDecl of the variable it captures
+static DeclNode *original_decl(DeclNode *decl)
+{
+    while (decl && decl->tag == NODE_CAPTURE_DECL)
+        decl = static_cast<CaptureDecl *>(decl)->decl_original;
+    return decl;
+}
 
 struct ResolveIdents final : public AstVisitor {
     Dynarr<DeclNode *> live_idents;
     Dynarr<FnDeclNode *> fn_nodes;
+    // captures of each fn in fn_nodes, copied into an arena slice of the right size once its body is resolved
+    Dynarr<Dynarr<CaptureDecl *>> fn_captures;
     Dynarr<ErrMsg> &errarr;
     Arena &arena;
 
@@ -34,20 +45,20 @@ struct ResolveIdents final : public AstVisitor {
         if (fn_depth == 0)
             return nullptr;
         // check function's captures
-        FnDeclNode *node = fn_nodes[fn_depth - 1];
-        for (i32 i = 0; i < node->capture_cnt; i++) {
-            if (node->captures[i]->span == span)
-                return node->captures[i];
+        Dynarr<CaptureDecl *> &captures = fn_captures[fn_depth - 1];
+        for (i32 i = 0; i < captures.len(); i++) {
+            if (captures[i]->span == span)
+                return captures[i];
         }
         // check in parent
         DeclNode *decl = resolve_ident_rec(span, fn_depth - 1, i);
         if (decl == nullptr || decl->fn_depth == 0)
             return decl;
         decl->flags |= FLAG_CAPTURED;
-        node->captures[node->capture_cnt] = alloc<CaptureDecl>(arena, span, decl);
-        node->captures[node->capture_cnt]->fn_depth = fn_depth;
-        node->capture_cnt++;
-        return node->captures[node->capture_cnt - 1];
+        CaptureDecl *capture = alloc<CaptureDecl>(arena, span, decl);
+        capture->fn_depth = fn_depth;
+        captures.push(capture);
+        return capture;
     }
 
     DeclNode *resolve_ident(Span span)
@@ -68,6 +79,7 @@ struct ResolveIdents final : public AstVisitor {
             decl_ident(node);
 
         fn_nodes.push(&node);
+        fn_captures.push(Dynarr<CaptureDecl *>());
         const i32 n_live_idents = live_idents.len();
         for (i32 i = 0; i < node.arity; i++)
             decl_ident(node.params[i]);
@@ -77,6 +89,10 @@ struct ResolveIdents final : public AstVisitor {
 
         for (i32 i = live_idents.len(); i > n_live_idents; i--)
             live_idents.pop();
+        const Dynarr<CaptureDecl *> &captures = fn_captures[fn_captures.len() - 1];
+        node.capture_cnt = captures.len();
+        node.captures = copy_slice(arena, captures.raw(), captures.len());
+        fn_captures.pop();
         fn_nodes.pop();
     }
 
@@ -106,6 +122,17 @@ struct ResolveIdents final : public AstVisitor {
             errarr.push({node.span, "not found in this scope"}); // TODO change error message
     }
 
+    void visit_assign(AssignNode &node) override
+    {
+        AstVisitor::visit_assign(node);
+        if (node.lhs->tag != NODE_IDENT)
+            return;
+        // an assignment through a capture reassigns the captured variable
+        DeclNode *decl = original_decl(static_cast<IdentNode &>(*node.lhs).decl);
+        if (decl)
+            decl->flags |= FLAG_ASSIGNED;
+    }
+
     void visit_block(BlockNode &node) override
     {
         const i32 n_live_idents = live_idents.len();
@@ -115,8 +142,22 @@ struct ResolveIdents final : public AstVisitor {
             live_idents.pop();
     }
 
-    void visit(ModuleNode &node)
+    void visit(ModuleNode &node, const VM &vm)
     {
+        // foreign fns defined by the VM are declared before the module's own globals,
+        // a global of the module with the same name shadows the foreign fn
+        for (i32 i = 0; i < vm.globals.len(); i++) {
+            const String &name = AS_FOREIGN_FN(vm.globals[i])->name->str;
+            const Span span = {name.chars(), name.len(), -1};
+            bool shadowed = false;
+            for (i32 j = 0; j < node.cnt && !shadowed; j++)
+                shadowed = node.decls[j]->span == span;
+            if (shadowed)
+                continue;
+            VarDeclNode *decl = alloc<VarDeclNode>(arena, span, nullptr);
+            decl->loc = {.tag = LOC_GLOBAL, .idx = i};
+            decl_ident(*decl);
+        }
         for (i32 i = 0; i < node.cnt; i++)
             decl_ident(*node.decls[i]);
         for (i32 i = 0; i < node.cnt; i++)
@@ -168,23 +209,205 @@ struct ResolveLoc final : public AstVisitor {
         n_locals = saved_n_locals;
     }
 
-    void visit(ModuleNode &node)
+    void visit(ModuleNode &node, const VM &vm)
     {
         for (i32 i = 0; i < node.cnt; i++) {
             if (node.decls[i]->tag == NODE_FN_DECL || node.decls[i]->tag == NODE_CLASS_DECL)
-                node.decls[i]->loc = {.tag = LOC_GLOBAL, .idx = i};
+                node.decls[i]->loc = {.tag = LOC_GLOBAL, .idx = vm.globals.len() + i};
         }
         for (i32 i = 0; i < node.cnt; i++)
             visit_stmt(*node.decls[i]);
     }
 };
 
-void analyze(ModuleNode &node, Dynarr<ErrMsg> &errarr, Arena &arena)
+bool is_num_expr(const Node &node)
+{
+    switch (node.tag) {
+    case NODE_ATOM: return static_cast<const AtomNode &>(node).atom_tag == TOKEN_NUMBER;
+    case NODE_IDENT: {
+        const DeclNode *decl = original_decl(static_cast<const IdentNode &>(node).decl);
+        return decl && decl->tag == NODE_VAR_DECL && (decl->flags & FLAG_NUM);
+    }
+    // these ops fail unless their operands are numbers
+    case NODE_UNARY: return static_cast<const UnaryNode &>(node).op_tag == TOKEN_MINUS;
+    case NODE_BINARY: {
+        const auto &binary = static_cast<const BinaryNode &>(node);
+        // clang-format off
+        switch (binary.op_tag) {
+        case TOKEN_MINUS:
+        case TOKEN_STAR:
+        case TOKEN_SLASH:
+        case TOKEN_SLASH_SLASH:
+        case TOKEN_PERCENT: return true;
+        case TOKEN_PLUS:    return is_num_expr(*binary.lhs) && is_num_expr(*binary.rhs);
+        default:            return false;
+        }
+        // clang-format on
+    }
+    case NODE_ASSIGN: {
+        const auto &assign = static_cast<const AssignNode &>(node);
+        if (assign.op_tag == TOKEN_EQ)
+            return is_num_expr(*assign.rhs);
+        if (assign.op_tag == TOKEN_PLUS_EQ)
+            return is_num_expr(*assign.lhs) && is_num_expr(*assign.rhs);
+        return true;
+    }
+    case NODE_CALL: {
+        const auto &call = static_cast<const CallNode &>(node);
+        if (call.lhs->tag != NODE_IDENT)
+            return false;
+        const DeclNode *decl = original_decl(static_cast<const IdentNode &>(*call.lhs).decl);
+        return decl && decl->tag == NODE_FN_DECL && (decl->flags & FLAG_RET_NUM);
+    }
+    default: return false;
+    }
+}
+
+// whether control never reaches the end of the stmt
+static bool always_returns(const Node &node)
+{
+    switch (node.tag) {
+    case NODE_RETURN: return true;
+    case NODE_BLOCK: {
+        const auto &block = static_cast<const BlockNode &>(node);
+        for (i32 i = 0; i < block.cnt; i++) {
+            if (always_returns(*block.stmts[i]))
+                return true;
+        }
+        return false;
+    }
+    case NODE_IF: {
+        const auto &if_node = static_cast<const IfNode &>(node);
+        return if_node.els && always_returns(*if_node.thn) && always_returns(*if_node.els);
+    }
+    default: return false;
+    }
+}
+
+// NOTE:
+// numeric type inference, used by the compiler to emit unchecked arithmetic.
+// a var or param gets FLAG_NUM if every value assigned or passed to it is a number, a fn gets FLAG_RET_NUM if
+// every value it returns is a number. every candidate starts out flagged and InferTypes clears flags until no
+// assignment, call or return contradicts them. starting optimistic is what lets the types of
+//      fn fib(n, a, b) { if (n == 0) { return b; } return fib(n-1, a + b, a); }
+// be inferred, as the types of n, a, b and of the result depend on each other.
+// params are only candidates while their fn is called directly by name, a fn used as a value may be called with
+// anything. methods are never candidates, reassigned fns never return a known type
+struct SeedTypes final : public AstVisitor {
+    void visit_var_decl(VarDeclNode &node) override
+    {
+        AstVisitor::visit_var_decl(node);
+        node.flags |= FLAG_NUM;
+    }
+
+    void visit_fn_decl(FnDeclNode &node) override
+    {
+        if (!(node.flags & (FLAG_METHOD | FLAG_ASSIGNED))) {
+            node.flags |= FLAG_RET_NUM;
+            for (i32 i = 0; i < node.arity; i++)
+                node.params[i].flags |= FLAG_NUM;
+        }
+        AstVisitor::visit_fn_decl(node);
+    }
+};
+
+struct InferTypes final : public AstVisitor {
+    FnDeclNode *fn;
+    bool changed;
+
+    InferTypes() : fn(nullptr), changed(false){};
+
+    void clear(DeclNode &decl, const u32 flag)
+    {
+        if (decl.flags & flag) {
+            decl.flags &= ~flag;
+            changed = true;
+        }
+    }
+
+    void visit_var_decl(VarDeclNode &node) override
+    {
+        AstVisitor::visit_var_decl(node);
+        if (!node.init || !is_num_expr(*node.init))
+            clear(node, FLAG_NUM);
+    }
+
+    void visit_ident(IdentNode &node) override
+    {
+        // the fn is used as a value rather than called
+        DeclNode *decl = original_decl(node.decl);
+        if (decl->tag != NODE_FN_DECL)
+            return;
+        FnDeclNode &fn_decl = static_cast<FnDeclNode &>(*decl);
+        for (i32 i = 0; i < fn_decl.arity; i++)
+            clear(fn_decl.params[i], FLAG_NUM);
+    }
+
+    void visit_assign(AssignNode &node) override
+    {
+        AstVisitor::visit_assign(node);
+        if (node.lhs->tag == NODE_IDENT && !is_num_expr(node))
+            clear(*original_decl(static_cast<IdentNode &>(*node.lhs).decl), FLAG_NUM);
+    }
+
+    void visit_call(CallNode &node) override
+    {
+        for (i32 i = 0; i < node.arity; i++)
+            visit_expr(*node.args[i]);
+        if (node.lhs->tag != NODE_IDENT) {
+            visit_expr(*node.lhs);
+            return;
+        }
+        DeclNode *decl = original_decl(static_cast<IdentNode &>(*node.lhs).decl);
+        // a call with the wrong number of args fails before the callee runs
+        if (decl->tag != NODE_FN_DECL || static_cast<FnDeclNode *>(decl)->arity != node.arity)
+            return;
+        FnDeclNode &callee = static_cast<FnDeclNode &>(*decl);
+        for (i32 i = 0; i < node.arity; i++) {
+            if (!is_num_expr(*node.args[i]))
+                clear(callee.params[i], FLAG_NUM);
+        }
+    }
+
+    void visit_return(ReturnNode &node) override
+    {
+        AstVisitor::visit_return(node);
+        if (!node.expr || !is_num_expr(*node.expr))
+            clear(*fn, FLAG_RET_NUM);
+    }
+
+    void visit_fn_decl(FnDeclNode &node) override
+    {
+        FnDeclNode *parent = fn;
+        fn = &node;
+        // falling off the end returns null
+        if (!always_returns(*node.body))
+            clear(node, FLAG_RET_NUM);
+        visit_block(*node.body);
+        fn = parent;
+    }
+};
+
+static void infer_types(ModuleNode &node)
+{
+    SeedTypes seed;
+    for (i32 i = 0; i < node.cnt; i++)
+        seed.visit_stmt(*node.decls[i]);
+    InferTypes infer;
+    do {
+        infer.changed = false;
+        for (i32 i = 0; i < node.cnt; i++)
+            infer.visit_stmt(*node.decls[i]);
+    } while (infer.changed);
+}
+
+void analyze(ModuleNode &node, const VM &vm, Dynarr<ErrMsg> &errarr, Arena &arena)
 {
     ResolveIdents pass0(errarr, arena);
-    pass0.visit(node);
+    pass0.visit(node, vm);
     if (errarr.len() > 0)
         return;
     ResolveLoc pass1;
-    pass1.visit(node);
+    pass1.visit(node, vm);
+    infer_types(node);
 }
@@ -2,5 +2,9 @@
 #include "../libflood/arena.h"
 #include "ast.h"
 #include "error.h"
+#include "vm.h"
 
-void analyze(ModuleNode &node, Dynarr<ErrMsg> &errarr, Arena &arena);
\ No newline at end of file
+void analyze(ModuleNode &node, const VM &vm, Dynarr<ErrMsg> &errarr, Arena &arena);
+
+// whether the expr provably evaluates to a number, using the types inferred by analyze
+bool is_num_expr(const Node &node);
@@ -0,0 +1,492 @@
+#include "serialize.h"
+#include "gc.h"
+#include <elf.h>
+#include <fcntl.h>
+#include <limits.h> // for PATH_MAX
+#include <spawn.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h> // for getpid()
+
+extern char **environ;
+
+#define IMAGE_MAGIC   (0x43444c46) // "FLDC"
+#define IMAGE_VERSION (2)          // bump when the layout of images changes
+#define IMAGE_SECTION ".flood"     // section of an executable written by write_executable that holds its image
+#define EMBEDDED_KEY  (0)          // the image is embedded in a copy of the flood that wrote it, so it is not keyed
+
+// clang-format off
+enum ImageTag : u8 {
+    IMAGE_NULL, IMAGE_BOOL, IMAGE_NUM, IMAGE_STRING, IMAGE_FN, IMAGE_FOREIGN_FN, IMAGE_LIST, IMAGE_CLASS
+};
+// clang-format on
+
+struct ImageHeader {
+    u32 magic;
+    u32 version;
+    u64 key;
+    i32 global_cnt;
+    i32 main_idx; // -1 if the module has no main
+};
+
+// the builtin classes of the vm, in the order they are stored
+static ClassObj *VM::*const builtin_classes[] = {&VM::list_class, &VM::string_class, &VM::string_builder_class,
+                                                  &VM::map_class,  &VM::set_class,    &VM::deque_class,
+                                                  &VM::f64array_class};
+
+// foreign fns are stored as the offset of their wrapper from run_vm. images are only read by the build of flood that
+// wrote them, so adding the address run_vm is loaded at relocates them
+static u64 wrapper_offset(const ForeignFnWrapper wrap)
+{
+    return reinterpret_cast<u64>(wrap) - reinterpret_cast<u64>(&run_vm);
+}
+
+static ForeignFnWrapper relocate_wrapper(const u64 offset)
+{
+    return reinterpret_cast<ForeignFnWrapper>(reinterpret_cast<u64>(&run_vm) + offset);
+}
+
+// FNV-1a
+static u64 hash_bytes(u64 hash, const void *data, const u64 len)
+{
+    const u8 *bytes = static_cast<const u8 *>(data);
+    for (u64 i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+u64 image_key(const char *source, const u64 len, const CompileOptions &options)
+{
+    u64 key = hash_bytes(0xcbf29ce484222325, source, len);
+    key = hash_bytes(key, &options.peephole, sizeof(options.peephole));
+    key = hash_bytes(key, &options.inline_threshold, sizeof(options.inline_threshold));
+    // the instruction set and the compiler change between builds, so a rebuilt flood does not read old images
+    struct stat exe;
+    if (stat("/proc/self/exe", &exe) == 0) {
+        key = hash_bytes(key, &exe.st_ino, sizeof(exe.st_ino));
+        key = hash_bytes(key, &exe.st_size, sizeof(exe.st_size));
+        key = hash_bytes(key, &exe.st_mtim, sizeof(exe.st_mtim));
+    }
+    return key;
+}
+
+struct ImageWriter {
+    Dynarr<u8> &out;
+
+    void put_bytes(const void *data, const u64 len)
+    {
+        const u8 *bytes = static_cast<const u8 *>(data);
+        for (u64 i = 0; i < len; i++)
+            out.push(bytes[i]);
+    }
+
+    template <typename T>
+    void put(const T val)
+    {
+        put_bytes(&val, sizeof(T));
+    }
+
+    void put_string(StringObj &str)
+    {
+        put<i32>(str.len);
+        put_bytes(str.data(), str.len);
+    }
+
+    void put_fn(FnObj &fn)
+    {
+        const Chunk &chunk = fn.chunk;
+        put_string(*fn.name);
+        put<i32>(fn.arity);
+        put<i32>(chunk.instrs_len());
+        put_bytes(chunk.instrs(), chunk.instrs_len());
+        put<i32>(chunk.lines().len());
+        put_bytes(chunk.lines().raw(), chunk.lines().len() * sizeof(i32));
+        put<i32>(chunk.inlined().len());
+        put_bytes(chunk.inlined().raw(), chunk.inlined().len() * sizeof(InlinedRange));
+        put<i32>(chunk.constants().len());
+        for (i32 i = 0; i < chunk.constants().len(); i++)
+            put_val(chunk.constants()[i]);
+    }
+
+    void put_foreign_fn(ForeignFnObj &fn)
+    {
+        put_string(*fn.name);
+        put<i32>(fn.arity);
+        put<u64>(wrapper_offset(fn.wrap));
+    }
+
+    // methods are closures, or foreign fns in the builtin classes
+    void put_class(ClassObj &klass)
+    {
+        put_string(*klass.name);
+        i32 method_cnt = 0;
+        for (i32 i = 0; i < klass.methods.cap(); i++)
+            method_cnt += klass.methods.slot(i).key != nullptr;
+        put<i32>(method_cnt);
+        for (i32 i = 0; i < klass.methods.cap(); i++) {
+            const Assoc &method = klass.methods.slot(i);
+            if (!method.key)
+                continue;
+            if (IS_FOREIGN_FN(method.val)) {
+                put<u8>(IMAGE_FOREIGN_FN);
+                put_foreign_fn(*AS_FOREIGN_FN(method.val));
+            } else {
+                put<u8>(IMAGE_FN);
+                put_string(*method.key);
+                put_fn(*AS_CLOSURE(method.val)->fn);
+            }
+        }
+    }
+
+    void put_val(const Value val)
+    {
+        if (IS_NULL(val)) {
+            put<u8>(IMAGE_NULL);
+        } else if (IS_BOOL(val)) {
+            put<u8>(IMAGE_BOOL);
+            put<u8>(AS_BOOL(val));
+        } else if (IS_NUM(val)) {
+            put<u8>(IMAGE_NUM);
+            put<double>(AS_NUM(val));
+        } else if (IS_STRING(val)) {
+            put<u8>(IMAGE_STRING);
+            put_string(*AS_STRING(val));
+        } else if (IS_FN(val)) {
+            put<u8>(IMAGE_FN);
+            put_fn(*AS_FN(val));
+        } else if (IS_LIST(val)) {
+            // a template of OP_LIST_CONST
+            const ListObj &list = *AS_LIST(val);
+            put<u8>(IMAGE_LIST);
+            put<i32>(list.len());
+            for (i32 i = 0; i < list.len(); i++)
+                put_val(list.get(i));
+        }
+    }
+
+    void put_global(const Value val)
+    {
+        if (IS_CLOSURE(val)) {
+            put<u8>(IMAGE_FN);
+            put_fn(*AS_CLOSURE(val)->fn);
+        } else if (IS_FOREIGN_FN(val)) {
+            put<u8>(IMAGE_FOREIGN_FN);
+            put_foreign_fn(*AS_FOREIGN_FN(val));
+        } else if (IS_CLASS(val)) {
+            put<u8>(IMAGE_CLASS);
+            put_class(*AS_CLASS(val));
+        } else {
+            put<u8>(IMAGE_NULL);
+        }
+    }
+};
+
+void write_image(Dynarr<u8> &out, VM &vm, const ClosureObj *main, const u64 key)
+{
+    ImageWriter writer = {out};
+    i32 main_idx = -1;
+    for (i32 i = 0; i < vm.globals.len(); i++) {
+        if (IS_OBJ(vm.globals[i]) && AS_OBJ(vm.globals[i]) == main)
+            main_idx = i;
+    }
+    writer.put<ImageHeader>({IMAGE_MAGIC, IMAGE_VERSION, key, vm.globals.len(), main_idx});
+    for (ClassObj *VM::*klass : builtin_classes)
+        writer.put_class(*(vm.*klass));
+    for (i32 i = 0; i < vm.globals.len(); i++)
+        writer.put_global(vm.globals[i]);
+}
+
+// every read checks that it stays within the image. once one fails ok is false and the rest return placeholders
+struct ImageReader {
+    VM &vm;
+    u8 *pos;
+    u8 *end;
+    bool ok;
+
+    u8 *get_bytes(const u64 len)
+    {
+        if (!ok || u64(end - pos) < len) {
+            ok = false;
+            return nullptr;
+        }
+        u8 *bytes = pos;
+        pos += len;
+        return bytes;
+    }
+
+    template <typename T>
+    T get()
+    {
+        T val{};
+        if (const u8 *bytes = get_bytes(sizeof(T)))
+            memcpy(&val, bytes, sizeof(T));
+        return val;
+    }
+
+    // number of elements of size elem_size that follow, checked against the bytes left
+    i32 get_cnt(const u64 elem_size)
+    {
+        const i32 cnt = get<i32>();
+        if (cnt < 0 || u64(end - pos) < cnt * elem_size)
+            ok = false;
+        return ok ? cnt : 0;
+    }
+
+    StringObj *get_string()
+    {
+        const i32 len = get_cnt(1);
+        const u8 *chars = get_bytes(len);
+        return alloc<StringObj>(vm, String(chars ? reinterpret_cast<const char *>(chars) : "", len));
+    }
+
+    FnObj *get_fn()
+    {
+        StringObj *name = get_string();
+        const i32 arity = get<i32>();
+        const i32 code_len = get_cnt(1);
+        u8 *code = get_bytes(code_len);
+        const i32 lines_len = get_cnt(sizeof(i32));
+        const u8 *line_bytes = get_bytes(lines_len * sizeof(i32));
+        // the runs of the line info must cover the code exactly, see chunk.h
+        Dynarr<i32> lines;
+        i64 covered = 0;
+        for (i32 i = 0; i < lines_len && ok; i++) {
+            i32 val;
+            memcpy(&val, line_bytes + i * sizeof(i32), sizeof(i32));
+            lines.push(val);
+            if (i % 2 == 1)
+                covered += val < 0 ? code_len + 1 : val;
+        }
+        if (lines_len % 2 != 0 || covered != code_len)
+            ok = false;
+        Chunk chunk;
+        if (ok)
+            chunk.map_code(code, code_len, move(lines));
+        const i32 inlined_cnt = get_cnt(sizeof(InlinedRange));
+        for (i32 i = 0; i < inlined_cnt; i++)
+            chunk.inlined().push(get<InlinedRange>());
+        const i32 const_cnt = get_cnt(1);
+        for (i32 i = 0; i < const_cnt && ok; i++)
+            chunk.add_constant(get_val());
+        return alloc<FnObj>(vm, name, move(chunk), arity);
+    }
+
+    ForeignFnObj *get_foreign_fn()
+    {
+        StringObj *name = get_string();
+        const i32 arity = get<i32>();
+        return alloc<ForeignFnObj>(vm, name, relocate_wrapper(get<u64>()), arity);
+    }
+
+    ClassObj *get_class()
+    {
+        ClassObj *klass = alloc<ClassObj>(vm, get_string());
+        const i32 method_cnt = get_cnt(1);
+        for (i32 i = 0; i < method_cnt && ok; i++) {
+            switch (get<u8>()) {
+            case IMAGE_FOREIGN_FN: {
+                // a foreign method is keyed by its own name, see define_foreign_method
+                ForeignFnObj *fn = get_foreign_fn();
+                klass->methods.insert(*fn->name, MK_OBJ(fn));
+                break;
+            }
+            case IMAGE_FN: {
+                StringObj *name = get_string();
+                klass->methods.insert(*name, MK_OBJ(alloc<ClosureObj>(vm, get_fn(), 0)));
+                break;
+            }
+            default: ok = false; break;
+            }
+        }
+        return klass;
+    }
+
+    Value get_val()
+    {
+        switch (get<u8>()) {
+        case IMAGE_NULL: return MK_NULL;
+        case IMAGE_BOOL: return MK_BOOL(get<u8>() != 0);
+        case IMAGE_NUM: return MK_NUM(get<double>());
+        case IMAGE_STRING: return MK_OBJ(get_string());
+        case IMAGE_FN: return MK_OBJ(get_fn());
+        case IMAGE_LIST: {
+            const i32 cnt = get_cnt(1);
+            Dynarr<Value> vals;
+            for (i32 i = 0; i < cnt && ok; i++)
+                vals.push(get_val());
+            return MK_OBJ(alloc<ListObj>(vm, vals.raw(), vals.len()));
+        }
+        default: ok = false; return MK_NULL;
+        }
+    }
+
+    Value get_global()
+    {
+        switch (get<u8>()) {
+        case IMAGE_NULL: return MK_NULL;
+        case IMAGE_FN: return MK_OBJ(alloc<ClosureObj>(vm, get_fn(), 0));
+        case IMAGE_FOREIGN_FN: return MK_OBJ(get_foreign_fn());
+        case IMAGE_CLASS: return MK_OBJ(get_class());
+        default: ok = false; return MK_NULL;
+        }
+    }
+};
+
+bool read_image(VM &vm, u8 *data, const u64 len, const u64 key, ClosureObj *&main)
+{
+    ImageReader reader = {vm, data, data + len, true};
+    const ImageHeader header = reader.get<ImageHeader>();
+    if (!reader.ok || header.magic != IMAGE_MAGIC || header.version != IMAGE_VERSION || header.key != key)
+        return false;
+    if (vm.list_class || vm.globals.len() > 0 || header.global_cnt < 0 || header.main_idx >= header.global_cnt)
+        return false;
+    for (ClassObj *VM::*klass : builtin_classes)
+        vm.*klass = reader.get_class();
+    for (i32 i = 0; i < header.global_cnt && reader.ok; i++)
+        vm.globals.push(reader.get_global());
+    // the objects read so far are left to the gc
+    if (!reader.ok || reader.pos != reader.end ||
+        (header.main_idx >= 0 && !IS_CLOSURE(vm.globals[header.main_idx]))) {
+        for (ClassObj *VM::*klass : builtin_classes)
+            vm.*klass = nullptr;
+        while (vm.globals.len() > 0)
+            vm.globals.pop();
+        return false;
+    }
+    main = header.main_idx >= 0 ? AS_CLOSURE(vm.globals[header.main_idx]) : nullptr;
+    return true;
+}
+
+// maps len bytes of the file at offset and reads them as an image. offset need not be page aligned
+static bool map_image(VM &vm, const i32 fd, const u64 offset, const u64 len, const u64 key, ClosureObj *&main)
+{
+    const u64 skip = offset % sysconf(_SC_PAGESIZE);
+    // the mapping is private, so quickening the code in place never writes back to the file. write_cache replaces
+    // the file instead of overwriting it, so the pages stay valid if the cache is rewritten while we run
+    void *data = mmap(nullptr, skip + len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, offset - skip);
+    if (data == MAP_FAILED)
+        return false;
+    if (!read_image(vm, static_cast<u8 *>(data) + skip, len, key, main)) {
+        // the fns that were read are unreachable, freeing them does not touch their code
+        munmap(data, skip + len);
+        return false;
+    }
+    vm.image = static_cast<u8 *>(data);
+    vm.image_len = skip + len;
+    return true;
+}
+
+bool read_cache(VM &vm, const char *path, const u64 key, ClosureObj *&main)
+{
+    char image_path[PATH_MAX];
+    if (snprintf(image_path, sizeof(image_path), "%sc", path) >= i32(sizeof(image_path)))
+        return false;
+    const i32 fd = open(image_path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    const bool ok = fstat(fd, &st) == 0 && st.st_size > 0 && map_image(vm, fd, 0, st.st_size, key, main);
+    close(fd);
+    return ok;
+}
+
+void write_cache(VM &vm, const char *path, const ClosureObj *main, const u64 key)
+{
+    char image_path[PATH_MAX];
+    char tmp_path[PATH_MAX];
+    if (snprintf(image_path, sizeof(image_path), "%sc", path) >= i32(sizeof(image_path)) ||
+        snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", image_path, getpid()) >= i32(sizeof(tmp_path)))
+        return;
+    Dynarr<u8> image;
+    write_image(image, vm, main, key);
+    // write to a temporary file and rename it, so that another process never reads a partial image
+    FILE *fp = fopen(tmp_path, "wb");
+    if (!fp)
+        return;
+    const bool ok = fwrite(image.raw(), 1, image.len(), fp) == u64(image.len());
+    if (fclose(fp) == 0 && ok)
+        rename(tmp_path, image_path);
+    else
+        remove(tmp_path);
+}
+
+// finds the section called name in the elf file fd, returns false if there is none or fd is not a 64-bit elf file
+static bool find_section(const i32 fd, const char *name, u64 &offset, u64 &len)
+{
+    Elf64_Ehdr ehdr;
+    if (pread(fd, &ehdr, sizeof(ehdr), 0) != sizeof(ehdr) || memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0 ||
+        ehdr.e_ident[EI_CLASS] != ELFCLASS64 || ehdr.e_shentsize != sizeof(Elf64_Shdr) ||
+        ehdr.e_shstrndx >= ehdr.e_shnum)
+        return false;
+    Dynarr<Elf64_Shdr> shdrs;
+    for (i32 i = 0; i < ehdr.e_shnum; i++)
+        shdrs.push({});
+    const u64 shdrs_size = ehdr.e_shnum * sizeof(Elf64_Shdr);
+    if (pread(fd, &shdrs[0], shdrs_size, ehdr.e_shoff) != i64(shdrs_size))
+        return false;
+    const Elf64_Shdr &strtab = shdrs[ehdr.e_shstrndx];
+    const u64 name_len = strlen(name) + 1;
+    char buf[64];
+    if (name_len > sizeof(buf))
+        return false;
+    for (i32 i = 0; i < shdrs.len(); i++) {
+        if (shdrs[i].sh_type == SHT_NOBITS || shdrs[i].sh_name >= strtab.sh_size ||
+            pread(fd, buf, name_len, strtab.sh_offset + shdrs[i].sh_name) != i64(name_len) ||
+            memcmp(buf, name, name_len) != 0)
+            continue;
+        offset = shdrs[i].sh_offset;
+        len = shdrs[i].sh_size;
+        return true;
+    }
+    return false;
+}
+
+bool read_embedded(VM &vm, ClosureObj *&main)
+{
+    const i32 fd = open("/proc/self/exe", O_RDONLY);
+    if (fd < 0)
+        return false;
+    u64 offset;
+    u64 len;
+    const bool ok =
+        find_section(fd, IMAGE_SECTION, offset, len) && len > 0 && map_image(vm, fd, offset, len, EMBEDDED_KEY, main);
+    close(fd);
+    return ok;
+}
+
+bool write_executable(VM &vm, const char *path, const ClosureObj *main)
+{
+    char exe_path[PATH_MAX];
+    char image_path[PATH_MAX];
+    char section_arg[PATH_MAX + sizeof(IMAGE_SECTION)];
+    // /proc/self/exe would name objcopy once it runs
+    const i64 exe_len = readlink("/proc/self/exe", exe_path, sizeof(exe_path));
+    if (exe_len <= 0 || exe_len == sizeof(exe_path) ||
+        snprintf(image_path, sizeof(image_path), "%s.%d.tmp", path, getpid()) >= i32(sizeof(image_path)))
+        return false;
+    exe_path[exe_len] = '\0';
+    snprintf(section_arg, sizeof(section_arg), IMAGE_SECTION "=%s", image_path);
+    Dynarr<u8> image;
+    write_image(image, vm, main, EMBEDDED_KEY);
+    FILE *fp = fopen(image_path, "wb");
+    if (!fp)
+        return false;
+    const bool written = fwrite(image.raw(), 1, image.len(), fp) == u64(image.len());
+    if (fclose(fp) != 0 || !written) {
+        remove(image_path);
+        return false;
+    }
+    // the executable is a copy of this flood, so the image can be read by it (see the key of images)
+    const char *args[] = {"objcopy", "--add-section", section_arg, exe_path, path, nullptr};
+    pid_t pid;
+    i32 status = 0;
+    const bool ok = posix_spawnp(&pid, "objcopy", nullptr, nullptr, const_cast<char **>(args), environ) == 0 &&
+              waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    remove(image_path);
+    return ok;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "compile.h"
+#include "object.h"
+#include "vm.h"
+
+// NOTE:
+// an image is a snapshot of the heap of a vm after compiling a module, so that a vm read from it can run main
+// without defining its builtins or running the front end
+//      header      magic, IMAGE_VERSION, key, global cnt, idx of main
+//      builtins    the builtin classes of the vm, with their foreign methods
+//      globals     each a fn, a foreign fn, a class with its methods, or null
+// fns are written with their code, line info, inlined ranges and constants, which may be nested fns.
+// images are only read by the build of flood that wrote them, so numbers are stored in native byte order
+// and the code is trusted like the output of the compiler.
+// the code of fns read from an image is not copied, it is run in place (see Chunk::map_code)
+
+// identifies the code this build of flood compiles from source with options, an image is only read back for the
+// same key
+u64 image_key(const char *source, const u64 len, const CompileOptions &options);
+
+// image of the builtins and globals of vm, main is the closure of `main` or nullptr
+void write_image(Dynarr<u8> &out, VM &vm, const ClosureObj *main, const u64 key);
+
+// fills in the builtins and globals of a vm constructed without builtins and sets main. returns false and leaves
+// the vm without builtins if the image is malformed or was written for another key. data must be writable, since
+// the vm quickens code, and outlive the fns that were read
+bool read_image(VM &vm, u8 *data, const u64 len, const u64 key, ClosureObj *&main);
+
+// the bytecode cache of the script at path is the image stored at path with `c` appended, e.g. script.flc.
+// failing to read or write the cache is not an error, the script is compiled instead.
+// read_cache maps the image and hands it to the vm, which unmaps it when it is destroyed
+bool read_cache(VM &vm, const char *path, const u64 key, ClosureObj *&main);
+void write_cache(VM &vm, const char *path, const ClosureObj *main, const u64 key);
+
+// an executable written by write_executable is a copy of this flood with the image of a module in a section of its
+// own. read_embedded reads the image of the running executable if it has one, like read_cache
+bool read_embedded(VM &vm, ClosureObj *&main);
+// uses objcopy, returns false if the executable could not be written
+bool write_executable(VM &vm, const char *path, const ClosureObj *main);
@@ -1,6 +1,7 @@
 #include "value.h"
 #include "object.h"
 #include <stdio.h>
+#include <string.h>
 
 bool val_eq(const Value val1, const Value val2)
 {
@@ -11,9 +12,15 @@ bool val_eq(const Value val1, const Value val2)
     case VAL_BOOL: return AS_BOOL(val1) == AS_BOOL(val2);
     case VAL_NUM:  return AS_NUM(val1) == AS_NUM(val2);
     case VAL_NULL: return true;
-    case VAL_OBJ:  return AS_OBJ(val1) == AS_OBJ(val2); // TODO proper string comparison (?)
+    case VAL_OBJ:  break;
     }
     // clang-format on
+    if (AS_OBJ(val1) == AS_OBJ(val2))
+        return true;
+    // strings are compared by content, every other object by identity
+    if (!IS_STRING(val1) || !IS_STRING(val2) || AS_STRING(val1)->len != AS_STRING(val2)->len)
+        return false;
+    return memcmp(AS_STRING(val1)->data(), AS_STRING(val2)->data(), AS_STRING(val1)->len) == 0;
 }
 
 void print_val(const Value val)
@@ -45,13 +52,12 @@ void print_val(const Value val)
         case OBJ_LIST: {
             printf("[");
             struct ListObj *list = AS_LIST(val);
-            const Dynarr<Value> &vals = list->vals;
-            if (vals.len() > 0) {
-                for (i32 i = 0; i < vals.len() - 1; i++) {
-                    print_val(vals[i]);
+            if (list->len() > 0) {
+                for (i32 i = 0; i < list->len() - 1; i++) {
+                    print_val(list->get(i));
                     printf(", ");
                 }
-                print_val(vals[vals.len() - 1]);
+                print_val(list->get(list->len() - 1));
             }
             printf("]");
             break;
@@ -63,7 +69,7 @@ void print_val(const Value val)
             break;
         }
         case OBJ_STRING: {
-            printf("%s", AS_STRING(val)->str.chars());
+            printf("%.*s", AS_STRING(val)->len, AS_STRING(val)->data());
             break;
         }
         case OBJ_CLASS: {
@@ -82,6 +88,54 @@ void print_val(const Value val)
             printf("<foreign method %s>", AS_FOREIGN_METHOD(val)->fn->name->str.chars());
             break;
         }
+        case OBJ_STRING_BUILDER: {
+            printf("<string builder>");
+            break;
+        }
+        case OBJ_DEQUE: {
+            printf("deque[");
+            const Ringbuf<Value> &vals = AS_DEQUE(val)->vals;
+            for (i32 i = 0; i < vals.len(); i++) {
+                if (i > 0)
+                    printf(", ");
+                print_val(vals[i]);
+            }
+            printf("]");
+            break;
+        }
+        case OBJ_F64ARRAY: {
+            printf("f64[");
+            const F64ArrayObj *arr = AS_F64ARRAY(val);
+            for (i32 i = 0; i < arr->len; i++) {
+                if (i > 0)
+                    printf(", ");
+                print_val(MK_NUM(arr->vals[i]));
+            }
+            printf("]");
+            break;
+        }
+        case OBJ_MAP:
+        case OBJ_SET: {
+            const bool is_map = tag == OBJ_MAP;
+            ValMap &map = is_map ? AS_MAP(val)->map : AS_SET(val)->map;
+            printf("{");
+            i32 printed = 0;
+            for (i32 i = 0; i < map.cap(); i++) {
+                const MapEntry &entry = map.slot(i);
+                if (entry.state != MAP_SLOT_FULL)
+                    continue;
+                if (printed > 0)
+                    printf(", ");
+                print_val(entry.key);
+                if (is_map) {
+                    printf(": ");
+                    print_val(entry.val);
+                }
+                printed++;
+            }
+            printf("}");
+            break;
+        }
         }
         AS_OBJ(val)->printed = 0;
         break;
@@ -128,6 +182,14 @@ Value *ValTable::find(const StringObj &key)
     return &assoc.val;
 }
 
+i32 ValTable::find_idx(const StringObj &key)
+{
+    Assoc &assoc = find_slot(key, vals, _cap);
+    if (assoc.key == nullptr)
+        return -1;
+    return &assoc - vals;
+}
+
 Assoc &ValTable::slot(const i32 idx)
 {
     return vals[idx];
@@ -137,3 +199,122 @@ i32 ValTable::cap() const
 {
     return _cap;
 }
+
+static u32 mix_bits(u64 bits)
+{
+    bits ^= bits >> 33;
+    bits *= 0xff51afd7ed558ccdull;
+    bits ^= bits >> 33;
+    return u32(bits);
+}
+
+u32 hash_val(const Value val)
+{
+    switch (val.tag) {
+    case VAL_NULL: return 1;
+    case VAL_BOOL: return AS_BOOL(val) ? 3 : 2;
+    case VAL_NUM: {
+        // adding 0.0 turns -0.0 into 0.0 so that keys which compare equal hash equal
+        const double num = AS_NUM(val) + 0.0;
+        u64 bits;
+        memcpy(&bits, &num, sizeof(bits));
+        return mix_bits(bits);
+    }
+    case VAL_OBJ:
+        if (IS_STRING(val))
+            return AS_STRING(val)->flat().hash();
+        return mix_bits(u64(AS_OBJ(val)));
+    }
+    return 0;
+}
+
+MapEntry &ValMap::find_slot(const Value key, const u32 hash, MapEntry *entries, const i32 cap)
+{
+    // returns the entry holding key if there is one, otherwise the slot the key should be inserted in
+    MapEntry *tombstone = nullptr;
+    i32 i = hash & (cap - 1);
+    while (true) {
+        MapEntry &entry = entries[i];
+        if (entry.state == MAP_SLOT_EMPTY)
+            return tombstone ? *tombstone : entry;
+        if (entry.state == MAP_SLOT_TOMBSTONE) {
+            if (tombstone == nullptr)
+                tombstone = &entry;
+        } else if (entry.hash == hash && val_eq(entry.key, key)) {
+            return entry;
+        }
+        i = (i + 1) & (cap - 1);
+    }
+}
+
+void ValMap::resize(const i32 new_cap)
+{
+    MapEntry *new_entries = new MapEntry[new_cap];
+    for (i32 i = 0; i < _cap; i++) {
+        if (entries[i].state != MAP_SLOT_FULL)
+            continue;
+        MapEntry &entry = find_slot(entries[i].key, entries[i].hash, new_entries, new_cap);
+        entry = entries[i];
+    }
+    delete[] entries;
+    entries = new_entries;
+    _cap = new_cap;
+    used = cnt;
+}
+
+void ValMap::insert(Value key, Value val)
+{
+    if (used + 1 > _cap * TABLE_LOAD_FACTOR) {
+        // if most of the used slots are tombstones rehashing at the same capacity is enough
+        i32 new_cap = _cap;
+        while (cnt + 1 > new_cap * TABLE_LOAD_FACTOR / 2)
+            new_cap *= 2;
+        resize(new_cap);
+    }
+    const u32 hash = hash_val(key);
+    MapEntry &entry = find_slot(key, hash, entries, _cap);
+    if (entry.state != MAP_SLOT_FULL) {
+        if (entry.state == MAP_SLOT_EMPTY)
+            used++;
+        cnt++;
+        entry.key = key;
+        entry.hash = hash;
+        entry.state = MAP_SLOT_FULL;
+    }
+    entry.val = val;
+}
+
+Value *ValMap::find(Value key)
+{
+    MapEntry &entry = find_slot(key, hash_val(key), entries, _cap);
+    if (entry.state != MAP_SLOT_FULL)
+        return nullptr;
+    return &entry.val;
+}
+
+bool ValMap::remove(Value key)
+{
+    MapEntry &entry = find_slot(key, hash_val(key), entries, _cap);
+    if (entry.state != MAP_SLOT_FULL)
+        return false;
+    entry.key = MK_NULL;
+    entry.val = MK_NULL;
+    entry.state = MAP_SLOT_TOMBSTONE;
+    cnt--;
+    return true;
+}
+
+MapEntry &ValMap::slot(const i32 idx)
+{
+    return entries[idx];
+}
+
+i32 ValMap::len() const
+{
+    return cnt;
+}
+
+i32 ValMap::cap() const
+{
+    return _cap;
+}
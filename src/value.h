@@ -57,7 +57,50 @@ public:
     void insert(StringObj &key, Value val);
 
     Value *find(const StringObj &key);
+    // idx of the slot holding key, or -1
+    i32 find_idx(const StringObj &key);
 
     Assoc &slot(const i32 idx);
     i32 cap() const;
 };
+
+enum MapSlotState : u8 { MAP_SLOT_EMPTY, MAP_SLOT_FULL, MAP_SLOT_TOMBSTONE };
+
+struct MapEntry {
+    Value key = MK_NULL;
+    Value val = MK_NULL;
+    u32 hash = 0;
+    MapSlotState state = MAP_SLOT_EMPTY;
+};
+
+u32 hash_val(Value val);
+
+// open addressing hash table keyed by arbitrary values. strings are compared by content,
+// every other object by identity (see val_eq)
+class ValMap {
+    i32 cnt;
+    i32 used; // full slots and tombstones
+    i32 _cap;
+    MapEntry *entries;
+
+    static MapEntry &find_slot(const Value key, const u32 hash, MapEntry *entries, const i32 cap);
+    void resize(const i32 new_cap);
+
+public:
+    ValMap() : cnt(0), used(0), _cap(8), entries(new MapEntry[_cap]) {}
+    ~ValMap()
+    {
+        delete[] entries;
+    }
+    ValMap(const ValMap &other) = delete;
+    ValMap &operator=(const ValMap &other) = delete;
+
+    void insert(Value key, Value val);
+    Value *find(Value key);
+    // returns whether the key was present
+    bool remove(Value key);
+
+    MapEntry &slot(const i32 idx);
+    i32 len() const;
+    i32 cap() const;
+};
@@ -1,10 +1,16 @@
 #include "vm.h"
+#include "../foreign/dequeobj_foreign.h"
+#include "../foreign/f64arrayobj_foreign.h"
 #include "../foreign/listobj_foreign.h"
+#include "../foreign/mapobj_foreign.h"
+#include "../foreign/stringobj_foreign.h"
 #include "ast.h"
+#include "jit.h"
 #include "object.h"
 #include <math.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <sys/mman.h>
 
 #include "debug.h"
 
@@ -36,16 +42,95 @@ InterpResult runtime_err(const u8 *ip, VM &vm, const char *format, ...)
     printf("\n");
     for (i32 i = vm.call_cnt - 1; i >= 0; i--) {
         const FnObj &fn = *vm.call_stack[i].closure->fn;
-        const i32 line = get_opcode_line(fn.chunk.lines(), vm.call_stack[i].ip - 1 - fn.chunk.code().raw());
+        const i32 offset = vm.call_stack[i].ip - 1 - fn.chunk.instrs();
+        i32 line = get_opcode_line(fn.chunk.lines(), offset);
+        // inlined calls do not push a frame, so their callees are listed from the chunk's inlined ranges
+        const Dynarr<InlinedRange> &inlined = fn.chunk.inlined();
+        for (i32 j = 0; j < inlined.len(); j++) {
+            if (offset < inlined[j].start || offset >= inlined[j].end)
+                continue;
+            printf("[line %d] in %s\n", line, AS_STRING(fn.chunk.constants()[inlined[j].name])->str.chars());
+            line = inlined[j].line;
+        }
         printf("[line %d] in %s\n", line, fn.name->str.chars());
     }
     return {.tag = INTERP_ERR, .message = ""}; // FIXME!!!
 }
 
-VM::VM() : call_stack(new CallFrame[MAX_CALL_FRAMES]), val_stack(new Value[MAX_STACK]), sp(val_stack), obj_list(nullptr)
+Tier tier_first_call(const VM &, const FnObj &)
+{
+    return TIER_NATIVE;
+}
+
+Tier tier_hot(const VM &vm, const FnObj &fn)
+{
+    return fn.call_cnt >= vm.hot_threshold ? TIER_NATIVE : TIER_INTERP;
+}
+
+void print_hot_fns(const VM &vm, const i32 n)
+{
+    // each pass picks the hottest fn after the ones picked so far, n is small
+    Dynarr<const FnObj *> hot;
+    for (i32 i = 0; i < n; i++) {
+        const FnObj *hottest = nullptr;
+        for (const Obj *obj = vm.obj_list; obj; obj = obj->next) {
+            const FnObj *fn = static_cast<const FnObj *>(obj);
+            if (obj->tag != OBJ_FN || fn->call_cnt == 0 || (hottest && fn->call_cnt <= hottest->call_cnt))
+                continue;
+            bool picked = false;
+            for (i32 j = 0; j < hot.len(); j++)
+                picked |= hot[j] == fn;
+            if (!picked)
+                hottest = fn;
+        }
+        if (!hottest)
+            break;
+        hot.push(hottest);
+    }
+    // native code does not count jumps, so the jumps of a fn stop growing once it is compiled
+    fprintf(stderr, "%12s  %12s  %s\n", "calls", "interp jumps", "fn");
+    for (i32 i = 0; i < hot.len(); i++) {
+        const FnObj &fn = *hot[i];
+        u64 jumps = 0;
+        i32 target = -1;
+        for (i32 j = 0; j < fn.jump_cnts.len(); j++) {
+            jumps += fn.jump_cnts[j];
+            if (fn.jump_cnts[j] > 0 && (target < 0 || fn.jump_cnts[j] > fn.jump_cnts[target]))
+                target = j;
+        }
+        fprintf(stderr, "%12llu  %12llu  %s [line %d]", static_cast<unsigned long long>(fn.call_cnt),
+            static_cast<unsigned long long>(jumps), fn.name->str.chars(), get_opcode_line(fn.chunk.lines(), 0));
+        if (target >= 0)
+            fprintf(stderr, ", jumps most to line %d", get_opcode_line(fn.chunk.lines(), target));
+        fprintf(stderr, "\n");
+    }
+}
+
+VM::VM(const bool builtins)
+    : call_stack(new CallFrame[MAX_CALL_FRAMES]), val_stack(new Value[MAX_STACK]), sp(val_stack), list_class(nullptr),
+      string_class(nullptr), string_builder_class(nullptr), map_class(nullptr), set_class(nullptr),
+      deque_class(nullptr), f64array_class(nullptr), image(nullptr), image_len(0), jit(false),
+      tier_policy(tier_first_call), hot_threshold(DEFAULT_HOT_THRESHOLD), perf_map(false),
+      code_heap(nullptr), obj_list(nullptr)
+{
+    if (builtins)
+        define_builtins();
+}
+
+void VM::define_builtins()
 {
     list_class = alloc<ClassObj>(*this, alloc<StringObj>(*this, "List"));
+    string_class = alloc<ClassObj>(*this, alloc<StringObj>(*this, "String"));
+    string_builder_class = alloc<ClassObj>(*this, alloc<StringObj>(*this, "StringBuilder"));
+    map_class = alloc<ClassObj>(*this, alloc<StringObj>(*this, "Map"));
+    set_class = alloc<ClassObj>(*this, alloc<StringObj>(*this, "Set"));
+    deque_class = alloc<ClassObj>(*this, alloc<StringObj>(*this, "Deque"));
+    f64array_class = alloc<ClassObj>(*this, alloc<StringObj>(*this, "F64Array"));
     define_list_methods(*this);
+    define_string_methods(*this);
+    define_map_methods(*this);
+    define_deque_methods(*this);
+    define_f64array_methods(*this);
 }
 
 VM::~VM()
@@ -57,6 +142,238 @@ VM::~VM()
         obj_list = obj->next;
         delete obj;
     }
+    if (image)
+        munmap(image, image_len);
+    delete code_heap;
+}
+
+bool get_subscr(VM &vm, const u8 *ip, const Value container, const Value idx, Value &out)
+{
+    if (IS_LIST(container)) {
+        if (!IS_NUM(idx)) {
+            runtime_err(ip, vm, "list index must be number");
+            return false;
+        }
+        if (AS_NUM(idx) < 0 || AS_NUM(idx) >= AS_LIST(container)->len()) {
+            runtime_err(ip, vm, "index %d out of bounds for list of size %d", i32(AS_NUM(idx)),
+                AS_LIST(container)->len());
+            return false;
+        }
+        out = AS_LIST(container)->get(u32(AS_NUM(idx)));
+        return true;
+    }
+    if (IS_STRING(container)) {
+        StringObj *str = AS_STRING(container);
+        if (!IS_NUM(idx)) {
+            runtime_err(ip, vm, "string index must be number");
+            return false;
+        }
+        if (AS_NUM(idx) < 0 || AS_NUM(idx) >= str->len) {
+            runtime_err(ip, vm, "index %d out of bounds for string of size %d", i32(AS_NUM(idx)), str->len);
+            return false;
+        }
+        const i32 i = AS_NUM(idx);
+        out = MK_OBJ(slice_string(vm, str, i, i + 1));
+        return true;
+    }
+    if (IS_DEQUE(container)) {
+        if (!IS_NUM(idx)) {
+            runtime_err(ip, vm, "deque index must be number");
+            return false;
+        }
+        if (AS_NUM(idx) < 0 || AS_NUM(idx) >= AS_DEQUE(container)->vals.len()) {
+            runtime_err(ip, vm, "index %d out of bounds for deque of size %d", i32(AS_NUM(idx)),
+                AS_DEQUE(container)->vals.len());
+            return false;
+        }
+        out = AS_DEQUE(container)->vals[u32(AS_NUM(idx))];
+        return true;
+    }
+    if (IS_F64ARRAY(container)) {
+        if (!IS_NUM(idx)) {
+            runtime_err(ip, vm, "f64 array index must be number");
+            return false;
+        }
+        if (AS_NUM(idx) < 0 || AS_NUM(idx) >= AS_F64ARRAY(container)->len) {
+            runtime_err(ip, vm, "index %d out of bounds for f64 array of size %d", i32(AS_NUM(idx)),
+                AS_F64ARRAY(container)->len);
+            return false;
+        }
+        out = MK_NUM(AS_F64ARRAY(container)->vals[u32(AS_NUM(idx))]);
+        return true;
+    }
+    if (IS_MAP(container)) {
+        Value *val = AS_MAP(container)->map.find(idx);
+        if (val == nullptr) {
+            runtime_err(ip, vm, "key not found in map");
+            return false;
+        }
+        out = *val;
+        return true;
+    }
+    runtime_err(ip, vm, "object is not subscriptable");
+    return false;
+}
+
+bool set_subscr(VM &vm, const u8 *ip, const Value container, const Value idx, const Value val)
+{
+    if (IS_LIST(container)) {
+        if (!IS_NUM(idx)) {
+            runtime_err(ip, vm, "list index must be number");
+            return false;
+        }
+        if (AS_NUM(idx) < 0 || AS_NUM(idx) >= AS_LIST(container)->len()) {
+            runtime_err(ip, vm, "index %d out of bounds for list of size %d", i32(AS_NUM(idx)),
+                AS_LIST(container)->len());
+            return false;
+        }
+        AS_LIST(container)->set(i32(AS_NUM(idx)), val);
+        return true;
+    }
+    if (IS_DEQUE(container)) {
+        if (!IS_NUM(idx)) {
+            runtime_err(ip, vm, "deque index must be number");
+            return false;
+        }
+        if (AS_NUM(idx) < 0 || AS_NUM(idx) >= AS_DEQUE(container)->vals.len()) {
+            runtime_err(ip, vm, "index %d out of bounds for deque of size %d", i32(AS_NUM(idx)),
+                AS_DEQUE(container)->vals.len());
+            return false;
+        }
+        AS_DEQUE(container)->vals[i32(AS_NUM(idx))] = val;
+        return true;
+    }
+    if (IS_F64ARRAY(container)) {
+        if (!IS_NUM(idx)) {
+            runtime_err(ip, vm, "f64 array index must be number");
+            return false;
+        }
+        if (!IS_NUM(val)) {
+            runtime_err(ip, vm, "f64 array element must be number");
+            return false;
+        }
+        if (AS_NUM(idx) < 0 || AS_NUM(idx) >= AS_F64ARRAY(container)->len) {
+            runtime_err(ip, vm, "index %d out of bounds for f64 array of size %d", i32(AS_NUM(idx)),
+                AS_F64ARRAY(container)->len);
+            return false;
+        }
+        AS_F64ARRAY(container)->vals[i32(AS_NUM(idx))] = AS_NUM(val);
+        return true;
+    }
+    if (IS_MAP(container)) {
+        AS_MAP(container)->map.insert(idx, val);
+        return true;
+    }
+    runtime_err(ip, vm, "object is not subscriptable");
+    return false;
+}
+
+// TODO symbols and interning to optimize
+bool get_field(VM &vm, const u8 *ip, const Value container, StringObj *prop, Value &out)
+{
+    if (!IS_INSTANCE(container)) {
+        runtime_err(ip, vm, "cannot get field of non-user-instance");
+        return false;
+    }
+    InstanceObj *instance = AS_INSTANCE(container);
+    Value *val = instance->fields.find(*prop);
+    if (val == nullptr) {
+        runtime_err(ip, vm, "`%s` instance does not have field `%s`", instance->klass->name->str.chars(),
+            prop->str.chars());
+        return false;
+    }
+    out = *val;
+    return true;
+}
+
+// TODO should distinguish between setting prop outside or within the instance
+bool set_field(VM &vm, const u8 *ip, const Value container, StringObj *prop, const Value val)
+{
+    if (!IS_INSTANCE(container)) {
+        runtime_err(ip, vm, "cannot set field of non-user-instance");
+        return false;
+    }
+    InstanceObj *instance = AS_INSTANCE(container);
+    Value *field = instance->fields.find(*prop);
+    if (field != nullptr) {
+        *field = val;
+    } else {
+        // TODO check if field exists. do not want to create field from outside
+        // TODO need insert_val_table take hash to avoid recomputing it
+        instance->fields.insert(*prop, val);
+    }
+    return true;
+}
+
+bool get_method(VM &vm, const u8 *ip, const Value val, StringObj *prop, Value &out)
+{
+    ClassObj *klass = nullptr;
+    if (IS_INSTANCE(val))
+        klass = AS_INSTANCE(val)->klass;
+    else if (IS_LIST(val))
+        klass = vm.list_class;
+    else if (IS_STRING(val))
+        klass = vm.string_class;
+    else if (IS_STRING_BUILDER(val))
+        klass = vm.string_builder_class;
+    else if (IS_MAP(val))
+        klass = vm.map_class;
+    else if (IS_SET(val))
+        klass = vm.set_class;
+    else if (IS_DEQUE(val))
+        klass = vm.deque_class;
+    else if (IS_F64ARRAY(val))
+        klass = vm.f64array_class;
+    if (klass == nullptr) {
+        runtime_err(ip, vm, "cannot get method of non-instance");
+        return false;
+    }
+    Value *fn = klass->methods.find(*prop);
+    if (fn == nullptr) {
+        runtime_err(ip, vm, "`%s` instance does not have method `%s`", klass->name->str.chars(), prop->str.chars());
+        return false;
+    }
+    if (AS_OBJ(*fn)->tag == OBJ_CLOSURE) {
+        // user-defined method, bind function to instance
+        out = MK_OBJ(alloc<MethodObj>(vm, AS_INSTANCE(val), AS_CLOSURE(*fn)));
+    } else {
+        out = MK_OBJ(alloc<ForeignMethodObj>(vm, AS_OBJ(val), AS_FOREIGN_FN(*fn)));
+    }
+    return true;
+}
+
+// NOTE:
+// quickening. a generic instruction that succeeds on a list or an instance rewrites itself in place into a form
+// specialized for it, which skips the type dispatch or the field lookup. the specialized form guards on its
+// assumption and when the guard fails rewrites itself back into the generic form, which then runs instead.
+// arithmetic is not quickened, the generic forms already only accept numbers (or strings for OP_ADD, which are
+// checked second) so a guarded form would do the same work
+static void quicken(const u8 *instr, const OpCode op)
+{
+    *const_cast<u8 *>(instr) = op;
+}
+
+static void quicken_field(Chunk &chunk, const u8 *instr, InstanceObj *instance, const OpCode op)
+{
+    const i32 slot = instance->fields.find_idx(*AS_STRING(chunk.constants()[instr[1]]));
+    FieldCache &cache = chunk.field_cache(instr[1]);
+    cache.key = instance->fields.slot(slot).key;
+    cache.slot = slot;
+    quicken(instr, op);
+}
+
+// the instance's field is in the slot the cache points to
+static bool field_cache_hit(const FieldCache &cache, const Value container)
+{
+    if (!IS_INSTANCE(container))
+        return false;
+    ValTable &fields = AS_INSTANCE(container)->fields;
+    return cache.slot < fields.cap() && fields.slot(cache.slot).key == cache.key;
+}
+
+static bool list_idx_in_bounds(const Value container, const Value idx)
+{
+    return IS_LIST(container) && IS_NUM(idx) && AS_NUM(idx) >= 0 && AS_NUM(idx) < AS_LIST(container)->len();
 }
 
 // TODO check if exceeding max stack size
@@ -74,7 +391,24 @@ InterpResult run_vm(VM &vm, ClosureObj &script)
     frame->bp = bp;
     vm.call_cnt = 1;
 
-    const u8 *ip = cur_closure->fn->chunk.code().raw();
+    const u8 *ip = cur_closure->fn->chunk.instrs();
+
+    // the script runs natively too, see OP_CALL
+    cur_closure->fn->call_cnt++;
+    if (vm.jit && tier_up(vm, *cur_closure->fn)) {
+        const JitStatus status = cur_closure->fn->jit(vm, frame, bp, sp);
+        if (status == JIT_ERR)
+            return {.tag = INTERP_ERR, .message = ""};
+        if (status == JIT_RETURN) {
+            vm.call_cnt--;
+            return {.tag = INTERP_OK, .val = bp[-1]};
+        }
+        frame = vm.call_stack + vm.call_cnt - 1;
+        cur_closure = frame->closure;
+        bp = frame->bp;
+        ip = frame->ip;
+        sp = vm.sp;
+    }
 
     while (true) {
         const u8 op = *ip;
@@ -101,8 +435,11 @@ InterpResult run_vm(VM &vm, ClosureObj &script)
             if (IS_NUM(lhs) && IS_NUM(rhs)) {
                 sp[-2] = MK_NUM(AS_NUM(lhs) + AS_NUM(rhs));
                 sp--;
+            } else if (IS_STRING(lhs) && IS_STRING(rhs)) {
+                sp[-2] = MK_OBJ(concat_strings(vm, AS_STRING(lhs), AS_STRING(rhs)));
+                sp--;
             } else {
-                return runtime_err(ip, vm, "operands must be numbers");
+                return runtime_err(ip, vm, "operands must be numbers or strings");
             }
             break;
         }
@@ -237,13 +574,111 @@ InterpResult run_vm(VM &vm, ClosureObj &script)
             }
             break;
         }
+        // the operands are known to be numbers, see is_num_expr
+        case OP_ADD_NUM: {
+            const Value lhs = sp[-2];
+            const Value rhs = sp[-1];
+            sp[-2] = MK_NUM(AS_NUM(lhs) + AS_NUM(rhs));
+            sp--;
+            break;
+        }
+        case OP_SUB_NUM: {
+            const Value lhs = sp[-2];
+            const Value rhs = sp[-1];
+            sp[-2] = MK_NUM(AS_NUM(lhs) - AS_NUM(rhs));
+            sp--;
+            break;
+        }
+        case OP_MUL_NUM: {
+            const Value lhs = sp[-2];
+            const Value rhs = sp[-1];
+            sp[-2] = MK_NUM(AS_NUM(lhs) * AS_NUM(rhs));
+            sp--;
+            break;
+        }
+        case OP_DIV_NUM: {
+            const Value lhs = sp[-2];
+            const Value rhs = sp[-1];
+            sp[-2] = MK_NUM(AS_NUM(lhs) / AS_NUM(rhs));
+            sp--;
+            break;
+        }
+        case OP_FLOORDIV_NUM: {
+            const Value lhs = sp[-2];
+            const Value rhs = sp[-1];
+            sp[-2] = MK_NUM(floor(AS_NUM(lhs) / AS_NUM(rhs)));
+            sp--;
+            break;
+        }
+        case OP_MOD_NUM: {
+            const Value lhs = sp[-2];
+            const Value rhs = sp[-1];
+            sp[-2] = MK_NUM(fmod(AS_NUM(lhs), AS_NUM(rhs)));
+            sp--;
+            break;
+        }
+        case OP_LT_NUM: {
+            const Value lhs = sp[-2];
+            const Value rhs = sp[-1];
+            sp[-2] = MK_BOOL(AS_NUM(lhs) < AS_NUM(rhs));
+            sp--;
+            break;
+        }
+        case OP_LEQ_NUM: {
+            const Value lhs = sp[-2];
+            const Value rhs = sp[-1];
+            sp[-2] = MK_BOOL(AS_NUM(lhs) <= AS_NUM(rhs));
+            sp--;
+            break;
+        }
+        case OP_GT_NUM: {
+            const Value lhs = sp[-2];
+            const Value rhs = sp[-1];
+            sp[-2] = MK_BOOL(AS_NUM(lhs) > AS_NUM(rhs));
+            sp--;
+            break;
+        }
+        case OP_GEQ_NUM: {
+            const Value lhs = sp[-2];
+            const Value rhs = sp[-1];
+            sp[-2] = MK_BOOL(AS_NUM(lhs) >= AS_NUM(rhs));
+            sp--;
+            break;
+        }
+        case OP_EQEQ_NUM: {
+            const Value lhs = sp[-2];
+            const Value rhs = sp[-1];
+            sp[-2] = MK_BOOL(AS_NUM(lhs) == AS_NUM(rhs));
+            sp--;
+            break;
+        }
+        case OP_NEQ_NUM: {
+            const Value lhs = sp[-2];
+            const Value rhs = sp[-1];
+            sp[-2] = MK_BOOL(AS_NUM(lhs) != AS_NUM(rhs));
+            sp--;
+            break;
+        }
         case OP_LIST: {
             const u8 cnt = *ip++;
             sp -= cnt;
-            Dynarr<Value> vals;
-            for (Value *v = sp; v < sp + cnt; v++)
-                vals.push(*v);
-            ListObj *list = alloc<ListObj>(vm, move(vals));
+            ListObj *list = alloc<ListObj>(vm, sp, cnt);
+            sp[0] = MK_OBJ(list);
+            sp++;
+            break;
+        }
+        case OP_LIST_LONG: {
+            const u16 cnt = (ip[0] << 8) | ip[1];
+            ip += 2;
+            sp -= cnt;
+            ListObj *list = alloc<ListObj>(vm, sp, cnt);
+            sp[0] = MK_OBJ(list);
+            sp++;
+            break;
+        }
+        case OP_LIST_CONST: {
+            const u8 idx = *ip++;
+            ListObj *list = alloc<ListObj>(vm, AS_LIST(cur_closure->fn->chunk.constants()[idx]));
             sp[0] = MK_OBJ(list);
             sp++;
             break;
@@ -314,46 +749,40 @@ InterpResult run_vm(VM &vm, ClosureObj &script)
         }
         case OP_GET_SUBSCR: {
             const Value container = sp[-2];
-            const Value idx = sp[-1];
-            if (IS_LIST(container)) {
-                if (IS_NUM(idx)) {
-                    if (AS_NUM(idx) >= 0 && AS_NUM(idx) < AS_LIST(container)->vals.len()) {
-                        sp[-2] = AS_LIST(container)->vals[u32(AS_NUM(idx))];
-                        sp--;
-                    } else {
-                        return runtime_err(ip, vm, "index %d out of bounds for list of size %d", i32(AS_NUM(idx)),
-                            AS_LIST(container)->vals.len());
-                    }
-
-                } else {
-                    return runtime_err(ip, vm, "list index must be number");
-                }
-            } else {
-                return runtime_err(ip, vm, "object is not subscriptable");
-            }
+            if (!get_subscr(vm, ip, container, sp[-1], sp[-2]))
+                return {.tag = INTERP_ERR, .message = ""};
+            if (IS_LIST(container))
+                quicken(ip - 1, OP_GET_SUBSCR_LIST);
+            sp--;
             break;
         }
         case OP_SET_SUBSCR: {
-            const Value val = sp[-3];
-            const Value container = sp[-2];
-            const Value idx = sp[-1];
-
-            if (IS_LIST(container)) {
-                if (IS_NUM(idx)) {
-                    if (AS_NUM(idx) >= 0 && AS_NUM(idx) < AS_LIST(container)->vals.len()) {
-                        AS_LIST(container)->vals[i32(AS_NUM(idx))] = val;
-                        // TODO consider making assignment a statement rather than an expression
-                        sp -= 2;
-                    } else {
-                        return runtime_err(ip, vm, "index %d out of bounds for list of size %d", i32(AS_NUM(idx)),
-                            i32(AS_LIST(container)->vals.len()));
-                    }
-                } else {
-                    return runtime_err(ip, vm, "list index must be number");
-                }
-            } else {
-                return runtime_err(ip, vm, "object is not subscriptable");
+            // TODO consider making assignment a statement rather than an expression
+            if (!set_subscr(vm, ip, sp[-2], sp[-1], sp[-3]))
+                return {.tag = INTERP_ERR, .message = ""};
+            if (IS_LIST(sp[-2]))
+                quicken(ip - 1, OP_SET_SUBSCR_LIST);
+            sp -= 2;
+            break;
+        }
+        case OP_GET_SUBSCR_LIST: {
+            if (!list_idx_in_bounds(sp[-2], sp[-1])) {
+                ip--;
+                quicken(ip, OP_GET_SUBSCR);
+                continue;
             }
+            sp[-2] = AS_LIST(sp[-2])->get(i32(AS_NUM(sp[-1])));
+            sp--;
+            break;
+        }
+        case OP_SET_SUBSCR_LIST: {
+            if (!list_idx_in_bounds(sp[-2], sp[-1])) {
+                ip--;
+                quicken(ip, OP_SET_SUBSCR);
+                continue;
+            }
+            AS_LIST(sp[-2])->set(i32(AS_NUM(sp[-1])), sp[-3]);
+            sp -= 2;
             break;
         }
         case OP_GET_GLOBAL: {
@@ -367,82 +796,67 @@ InterpResult run_vm(VM &vm, ClosureObj &script)
             vm.globals[idx] = sp[-1];
             break;
         }
-        // TODO symbols and interning to optimize
         case OP_GET_FIELD: {
             const u8 idx = *ip++;
             StringObj *prop = AS_STRING(cur_closure->fn->chunk.constants()[idx]);
-            Value val = sp[-1];
-            if (IS_INSTANCE(val)) {
-                InstanceObj *instance = AS_INSTANCE(val);
-                Value *val = instance->fields.find(*prop);
-                if (val != nullptr) {
-                    sp[-1] = *val;
-                    break;
-                }
-                return runtime_err(ip, vm, "`%s` instance does not have field `%s`", instance->klass->name->str.chars(),
-                    prop->str.chars());
-            }
-            return runtime_err(ip, vm, "cannot get field of non-user-instance");
+            const Value container = sp[-1];
+            if (!get_field(vm, ip, container, prop, sp[-1]))
+                return {.tag = INTERP_ERR, .message = ""};
+            quicken_field(cur_closure->fn->chunk, ip - 2, AS_INSTANCE(container), OP_GET_FIELD_CACHED);
+            break;
         }
-        // TODO should distinguish between setting prop outside or within the instance
         case OP_SET_FIELD: {
             const u8 idx = *ip++;
             StringObj *prop = AS_STRING(cur_closure->fn->chunk.constants()[idx]);
-            Value container = sp[-1];
-            if (IS_INSTANCE(container)) {
-                InstanceObj *instance = AS_INSTANCE(container);
-                Value *val = instance->fields.find(*prop);
-                if (val != nullptr) {
-                    *val = sp[-2];
-                } else {
-                    // TODO check if field exists. do not want to create field from outside
-                    // TODO need insert_val_table take hash to avoid recomputing it
-                    instance->fields.insert(*prop, sp[-2]);
-                }
-                sp--;
-                break;
+            if (!set_field(vm, ip, sp[-1], prop, sp[-2]))
+                return {.tag = INTERP_ERR, .message = ""};
+            quicken_field(cur_closure->fn->chunk, ip - 2, AS_INSTANCE(sp[-1]), OP_SET_FIELD_CACHED);
+            sp--;
+            break;
+        }
+        case OP_GET_FIELD_CACHED: {
+            const FieldCache &cache = cur_closure->fn->chunk.field_cache(*ip++);
+            if (!field_cache_hit(cache, sp[-1])) {
+                ip -= 2;
+                quicken(ip, OP_GET_FIELD);
+                continue;
+            }
+            sp[-1] = AS_INSTANCE(sp[-1])->fields.slot(cache.slot).val;
+            break;
+        }
+        case OP_SET_FIELD_CACHED: {
+            const FieldCache &cache = cur_closure->fn->chunk.field_cache(*ip++);
+            if (!field_cache_hit(cache, sp[-1])) {
+                ip -= 2;
+                quicken(ip, OP_SET_FIELD);
+                continue;
             }
-            return runtime_err(ip, vm, "cannot set field of non-user-instance");
+            AS_INSTANCE(sp[-1])->fields.slot(cache.slot).val = sp[-2];
+            sp--;
+            break;
         }
         // TODO implement OP_INVOKE optimization
         case OP_GET_METHOD: {
             const u8 idx = *ip++;
             StringObj *prop = AS_STRING(cur_closure->fn->chunk.constants()[idx]);
-            Value val = sp[-1];
-            ClassObj *klass = nullptr;
-            if (IS_INSTANCE(val))
-                klass = AS_INSTANCE(val)->klass;
-            else if (IS_LIST(val))
-                klass = vm.list_class;
-            if (klass) {
-                Value *fn = klass->methods.find(*prop);
-                if (fn) {
-                    if (AS_OBJ(*fn)->tag == OBJ_CLOSURE) {
-                        // user-defined method, bind function to instance
-                        auto method = alloc<MethodObj>(vm, AS_INSTANCE(val), AS_CLOSURE(*fn));
-                        sp[-1] = MK_OBJ(method);
-                    } else {
-                        auto method = alloc<ForeignMethodObj>(vm, AS_OBJ(val), AS_FOREIGN_FN(*fn));
-                        sp[-1] = MK_OBJ(method);
-                    }
-                    break;
-                }
-                return runtime_err(
-                    ip, vm, "`%s` instance does not have method `%s`", klass->name->str.chars(), prop->str.chars());
-            }
-            return runtime_err(ip, vm, "cannot get method of non-instance");
+            if (!get_method(vm, ip, sp[-1], prop, sp[-1]))
+                return {.tag = INTERP_ERR, .message = ""};
+            break;
         }
         case OP_JUMP: {
             const u16 offset = (ip += 2, (ip[-2] << 8) | ip[-1]);
             ip += offset;
+            cur_closure->fn->count_jump(ip);
             break;
         }
         case OP_JUMP_IF_FALSE: {
             const u16 offset = (ip += 2, (ip[-2] << 8) | ip[-1]);
             const Value val = sp[-1];
             if (IS_BOOL(val)) {
-                if (!AS_BOOL(val))
+                if (!AS_BOOL(val)) {
                     ip += offset;
+                    cur_closure->fn->count_jump(ip);
+                }
             } else {
                 return runtime_err(ip, vm, "operand must be boolean");
             }
@@ -452,8 +866,10 @@ InterpResult run_vm(VM &vm, ClosureObj &script)
             const u16 offset = (ip += 2, (ip[-2] << 8) | ip[-1]);
             const Value val = sp[-1];
             if (IS_BOOL(val)) {
-                if (AS_BOOL(val))
+                if (AS_BOOL(val)) {
                     ip += offset;
+                    cur_closure->fn->count_jump(ip);
+                }
             } else {
                 return runtime_err(ip, vm, "operand must be boolean");
             }
@@ -487,7 +903,18 @@ InterpResult run_vm(VM &vm, ClosureObj &script)
                 sp[0] = MK_OBJ(f_method->self);
                 sp++;
                 frame->ip = ip;
-                InterpResult res = f_method->fn->wrap(sp - param_cnt);
+                InterpResult res = f_method->fn->wrap(vm, sp - param_cnt);
+                if (res.tag == INTERP_ERR)
+                    return runtime_err(ip, vm, res.message);
+                sp -= param_cnt;
+                sp[-1] = res.val;
+                break;
+            } else if (IS_FOREIGN_FN(val)) {
+                ForeignFnObj *f_fn = AS_FOREIGN_FN(val);
+                if (param_cnt != f_fn->arity)
+                    return runtime_err(ip, vm, "incorrect number of arguments provided");
+                frame->ip = ip;
+                InterpResult res = f_fn->wrap(vm, sp - param_cnt);
                 if (res.tag == INTERP_ERR)
                     return runtime_err(ip, vm, res.message);
                 sp -= param_cnt;
@@ -507,8 +934,30 @@ InterpResult run_vm(VM &vm, ClosureObj &script)
             cur_closure = closure;
             frame->closure = cur_closure;
             bp = sp - param_cnt;
-            ip = cur_closure->fn->chunk.code().raw();
+            ip = cur_closure->fn->chunk.instrs();
             vm.call_cnt++;
+            cur_closure->fn->call_cnt++;
+            if (!vm.jit || !tier_up(vm, *cur_closure->fn))
+                break;
+            const JitStatus status = cur_closure->fn->jit(vm, frame, bp, sp);
+            if (status == JIT_ERR)
+                return {.tag = INTERP_ERR, .message = ""};
+            if (status == JIT_DEOPT) {
+                // a fn deopted somewhere up the calls the native code made, which are all frames now
+                frame = vm.call_stack + vm.call_cnt - 1;
+                cur_closure = frame->closure;
+                bp = frame->bp;
+                ip = frame->ip;
+                sp = vm.sp;
+                break;
+            }
+            // see OP_RETURN
+            vm.call_cnt--;
+            sp = bp;
+            frame--;
+            ip = frame->ip;
+            bp = frame->bp;
+            cur_closure = frame->closure;
             break;
         }
         case OP_RETURN: {
@@ -3,8 +3,13 @@
 #define MAX_CALL_FRAMES (1024) // TODO implement tail call optimization
 #define MAX_STACK       (MAX_CALL_FRAMES * 256)
 
+#define DEFAULT_HOT_THRESHOLD (1000) // see tier_hot
+
 struct ClosureObj;
 struct ClassObj;
+struct StringObj;
+struct FnObj;
+class CodeHeap;
 
 struct CallFrame {
     ClosureObj *closure;
@@ -22,6 +27,27 @@ struct InterpResult {
     };
 };
 
+struct VM;
+
+// how a fn compiled to native code stopped running, see jit.h
+enum JitStatus {
+    JIT_RETURN, // its result is in bp[-1]
+    JIT_ERR,    // the error has been reported
+    JIT_DEOPT,  // the top frame is resumed by the interpreter from its ip and vm.sp
+};
+
+typedef JitStatus (*JitFn)(VM &vm, CallFrame *frame, Value *bp, Value *sp);
+
+// the tiers a fn runs in. code is quickened in place by the interpreter and calls are inlined by the compiler, so
+// native code is the only tier a fn is promoted to while it runs
+enum Tier {
+    TIER_INTERP,
+    TIER_NATIVE,
+};
+
+// decides from the counters of fn which tier it runs in. it is asked on every call of a fn that is not native yet
+typedef Tier (*TierPolicy)(const VM &vm, const FnObj &fn);
+
 struct VM {
     CallFrame *call_stack;
     u16 call_cnt;
@@ -30,17 +56,56 @@ struct VM {
     Value *sp;
 
     ClassObj *list_class;
+    ClassObj *string_class;
+    ClassObj *string_builder_class;
+    ClassObj *map_class;
+    ClassObj *set_class;
+    ClassObj *deque_class;
+    ClassObj *f64array_class;
 
+    // foreign fns defined by the VM come first, followed by the globals of the module
     Dynarr<Value> globals;
 
+    // image the module was read from, see read_cache. its code is run in place so it is unmapped with the vm
+    u8 *image;
+    u64 image_len;
+
+    // compile fns to native code when tier_policy promotes them, see jit.h
+    bool jit;
+    TierPolicy tier_policy;
+    u64 hot_threshold; // calls of a fn before tier_hot promotes it
+    bool perf_map;     // name native code for perf, see CodeHeap::add_perf_map
+    CodeHeap *code_heap;
+
     // linked list of all objects
     Obj *obj_list;
     Dynarr<Obj *> gray;
 
-    VM();
+    // a vm without builtins has its builtin classes null, it must not run code until they are defined or read
+    // from an image, see read_cache
+    explicit VM(const bool builtins = true);
     ~VM();
+    void define_builtins();
 };
 
 InterpResult runtime_err(const u8 *ip, VM &vm, const char *format, ...);
 
+// promotes every fn on its first call, the default
+Tier tier_first_call(const VM &vm, const FnObj &fn);
+// promotes a fn once it has been called vm.hot_threshold times
+Tier tier_hot(const VM &vm, const FnObj &fn);
+// prints the n fns called most often to stderr, with the jumps the interpreters took in each and the line jumped to
+// most often
+void print_hot_fns(const VM &vm, const i32 n);
+
+// operations shared by the stack and register interpreters. on failure they report the error with runtime_err
+// and return false
+bool get_subscr(VM &vm, const u8 *ip, const Value container, const Value idx, Value &out);
+bool set_subscr(VM &vm, const u8 *ip, const Value container, const Value idx, const Value val);
+bool get_field(VM &vm, const u8 *ip, const Value container, StringObj *prop, Value &out);
+bool set_field(VM &vm, const u8 *ip, const Value container, StringObj *prop, const Value val);
+bool get_method(VM &vm, const u8 *ip, const Value val, StringObj *prop, Value &out);
+
 InterpResult run_vm(VM &vm, ClosureObj &closure);
+// runs a closure compiled by compile_reg
+InterpResult run_reg_vm(VM &vm, ClosureObj &closure);
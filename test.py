@@ -1,28 +1,48 @@
 import argparse
 import filecmp
+import os
+import re
 import subprocess
 import tempfile
 
 from pathlib import Path    
 
+def is_test(path: Path) -> bool:
+    # flood writes the bytecode cache of a script next to it, with `c` appended to the name
+    is_cache = path.name.endswith("c") and path.with_name(path.name[:-1]).is_file()
+    return path.is_file() and not is_cache
+
 def to_snap_path(test_path: Path) -> Path:
     return Path("snapshots") / test_path.relative_to("tests").with_suffix(".out")
 
 def clean_all() -> None:
-    snap_paths_keep = set([to_snap_path(path) for path in Path("tests").glob("**/*") if path.is_file()])
+    snap_paths_keep = set([to_snap_path(path) for path in Path("tests").glob("**/*") if is_test(path)])
     snap_paths_all = set([path for path in Path("snapshots").glob("**/*") if path.is_file()])
     snap_paths_clean = snap_paths_all - snap_paths_keep
     for snap_path in snap_paths_clean:  
         print(f"\033[32mcleaned: {snap_path}\033[0m")  
         snap_path.unlink()
 
-def diff(test_path: Path) -> None:
+def run_built(test_path: Path, build_args: list[str], flood_args: list[str], out) -> None:
+    # the compile errors of a script are printed when it is built. the executable runs the module it holds whatever
+    # its arguments, so it is given some that flood would fail on
+    with tempfile.TemporaryDirectory() as tmp_dir:
+        exe_path = Path(tmp_dir) / "app"
+        build = subprocess.run(["./build/flood", "build", *build_args, *flood_args, test_path, "-o", exe_path], stdout=out)
+        if build.returncode == 0:
+            subprocess.run([exe_path, "--register-vm", Path(tmp_dir) / "missing.fl"], stdout=out)
+
+# build_args are passed to `flood build` if the test runs as an executable, None if flood runs it
+def diff(test_path: Path, flood_args: list[str], build_args: list[str] | None = None) -> None:
     snap_path = to_snap_path(test_path)
     if not snap_path.is_file():
         print(f"\033[31msnapshot `{snap_path}` does not exist.\033[0m")
         return
     with tempfile.NamedTemporaryFile("w+") as tmp, open(snap_path, "r") as snapshot:
-        subprocess.run(["./build/flood", test_path], stdout=tmp)
+        if build_args is not None:
+            run_built(test_path, build_args, flood_args, tmp)
+        else:
+            subprocess.run(["./build/flood", *flood_args, test_path], stdout=tmp)
         tmp.flush()
         tmp.seek(0)
         if filecmp.cmp(tmp.name, snap_path):
@@ -56,6 +76,95 @@ def leak_check(test_path: Path) -> None:
             print(f"\033[31m{test_path}\033[0m")
             print(tmp.read(),end="")
 
+def cache_check() -> None:
+    # flood reads back the cache of a script only while it was written for the same source, and compiles the script
+    # again (and rewrites the cache) if it was edited or if the cache cannot be read
+    def check(name: str, script: Path, expected: str) -> None:
+        out = subprocess.run(["./build/flood", script], capture_output=True, text=True).stdout
+        if out == expected:
+            print(f"\033[32m{name}\033[0m")
+        else:
+            print(f"\033[31m{name}\033[0m")
+            print(out, end="")
+
+    with tempfile.TemporaryDirectory() as tmp_dir:
+        script = Path(tmp_dir) / "script.fl"
+        cache = script.with_name(script.name + "c")
+        script.write_text("fn main() { print 1; }\n")
+        check("cache written", script, "1\n")
+        if not cache.is_file():
+            print(f"\033[31m`{cache}` was not written\033[0m")
+            return
+        image = cache.read_bytes()
+        written = cache.stat().st_mtime_ns
+        check("cache read", script, "1\n")
+        if cache.stat().st_mtime_ns != written:
+            print(f"\033[31m`{cache}` was rewritten although it was up to date\033[0m")
+        # same length, so only the contents tell the sources apart
+        script.write_text("fn main() { print 2; }\n")
+        check("source edited", script, "2\n")
+        if cache.read_bytes() == image:
+            print(f"\033[31m`{cache}` was not rewritten\033[0m")
+        image = cache.read_bytes()
+        corruptions = {
+            "cache truncated": image[: len(image) // 2],
+            "cache empty": b"",
+            "cache header corrupted": bytes(8) + image[8:],
+            "cache with trailing bytes": image + bytes(16),
+        }
+        for name, data in corruptions.items():
+            cache.write_bytes(data)
+            check(name, script, "2\n")
+            if cache.read_bytes() != image:
+                print(f"\033[31m`{cache}` was not rewritten after: {name}\033[0m")
+
+def hot_report_check() -> None:
+    # calls are counted in every tier, jumps only while a fn is interpreted, so fewer are counted the sooner fib is
+    # compiled
+    def check(name: str, script: Path, flood_args: list[str], jumps) -> None:
+        run = subprocess.run(["./build/flood", "--hot-report", *flood_args, script], capture_output=True, text=True)
+        rows = [line.split() for line in run.stderr.splitlines()[1:]]
+        fib = next((row for row in rows if row[2] == "fib"), None)
+        if run.stdout == "55\n" and fib and fib[0] == "177" and jumps(int(fib[1])):
+            print(f"\033[32m{name}\033[0m")
+        else:
+            print(f"\033[31m{name}\033[0m")
+            print(run.stderr, end="")
+
+    with tempfile.TemporaryDirectory() as tmp_dir:
+        script = Path(tmp_dir) / "script.fl"
+        script.write_text(
+            "fn fib(n) {\n    if (n < 2) {\n        return n;\n    }\n    return fib(n - 1) + fib(n - 2);\n}\n"
+            "fn main() {\n    print fib(10);\n}\n"
+        )
+        check("hot report interpreted", script, [], lambda jumps: jumps == 88)
+        check("hot report --jit-threshold 5", script, ["--jit-threshold", "5"], lambda jumps: 0 < jumps < 88)
+        check("hot report --jit", script, ["--jit"], lambda jumps: jumps == 0)
+
+def perf_map_check() -> None:
+    # --perf-map compiles fns to native code and names each in /tmp/perf-<pid>.map as flood:<fn>:<line>
+    with tempfile.TemporaryDirectory() as tmp_dir:
+        script = Path(tmp_dir) / "script.fl"
+        # fact is recursive, so it is not inlined into main
+        script.write_text(
+            "fn fact(n) {\n    if (n < 2) {\n        return 1;\n    }\n    return n * fact(n - 1);\n}\n"
+            "fn main() {\n    print fact(5);\n}\n"
+        )
+        run = subprocess.Popen(["./build/flood", "--perf-map", script], stdout=subprocess.DEVNULL)
+        run.wait()
+        map_path = Path(f"/tmp/perf-{run.pid}.map")
+        if not map_path.is_file():
+            print(f"\033[31m`{map_path}` was not written\033[0m")
+            return
+        lines = map_path.read_text().splitlines()
+        map_path.unlink()
+        names = [match[1] for line in lines if (match := re.fullmatch(r"[0-9a-f]+ [0-9a-f]+ (flood:\w+:\d+)", line))]
+        if len(names) == len(lines) and "flood:fact:2" in names and "flood:main:8" in names:
+            print("\033[32mperf map\033[0m")
+        else:
+            print("\033[31mperf map\033[0m")
+            print("\n".join(lines))
+
 def main() -> None:
     parser = argparse.ArgumentParser()
     group = parser.add_mutually_exclusive_group(required=True)
@@ -64,7 +173,19 @@ def main() -> None:
     group.add_argument("--upgrade-single", type=str)
     group.add_argument("--clean", action="store_true")
     group.add_argument("--leak-check", action="store_true")
+    group.add_argument("--cache-check", action="store_true", help="check that stale or broken caches are recompiled")
+    group.add_argument("--hot-report-check", action="store_true", help="check the counts of --hot-report in each tier")
+    group.add_argument("--perf-map-check", action="store_true", help="check that --perf-map names the native fns")
+    parser.add_argument("--register-vm", action="store_true", help="run --diff with the register interpreter")
+    parser.add_argument("--jit", action="store_true", help="run --diff with fns compiled to native code")
+    parser.add_argument("--tiered", action="store_true", help="run --diff with --jit-threshold 1, 2 and 5")
+    parser.add_argument("--build", action="store_true", help="run --diff with executables built by `flood build`")
+    parser.add_argument("--native", action="store_true", help="run --diff with executables built by `flood build --native`")
+    parser.add_argument("--simd", choices=["scalar", "sse2", "avx"], help="run with the F64Array kernels of this set")
     args = parser.parse_args()
+    # flood and the executables it builds read FLOOD_SIMD, see f64kernels.h
+    if args.simd:
+        os.environ["FLOOD_SIMD"] = args.simd
 
     Path("tests").mkdir(exist_ok=True)
     Path("snapshots").mkdir(exist_ok=True)
@@ -72,6 +193,15 @@ def main() -> None:
     if args.clean:
         clean_all()
         return
+    if args.cache_check:
+        cache_check()
+        return
+    if args.hot_report_check:
+        hot_report_check()
+        return
+    if args.perf_map_check:
+        perf_map_check()
+        return
     if args.upgrade_single:
         test_path = Path(args.upgrade_single)
         if not test_path.is_file():
@@ -96,10 +226,16 @@ def main() -> None:
             print(f"`{dir_path}` does not exist or is not a directory.")
             continue
         for test_path in dir_path.glob("**/*"):
-            if not test_path.is_file():
+            if not is_test(test_path):
                 continue
-            if args.diff:
-                diff(test_path)
+            if args.diff and args.tiered:
+                # fns are interpreted for their first n - 1 calls, then run as native code
+                for threshold in [1, 2, 5]:
+                    diff(test_path, ["--jit-threshold", str(threshold)])
+            elif args.diff:
+                flood_args = ["--register-vm"] if args.register_vm else ["--jit"] if args.jit else []
+                build_args = ["--native"] if args.native else [] if args.build else None
+                diff(test_path, flood_args, build_args)
             elif args.upgrade:       
                 upgrade(test_path) 
             else: